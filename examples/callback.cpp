@@ -49,6 +49,8 @@ int main(int argc, char* argv[]) {
           .global_config_path = std::filesystem::path("/code/ton/ton-multiclient/global-config.json"),
           .key_store_root = std::filesystem::path("/code/ton/ton-multiclient/keystore"),
           .scheduler_threads = 6,
+          // JSON encoding and logging in `Cb` run on the dispatch thread, not on the workers.
+          .callback_dispatch = multiclient::CallbackDispatchConfig{},
       },
       std::make_unique<Cb>(requests)
   );
@@ -0,0 +1,109 @@
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "auto/tl/tonlib_api.h"
+#include "multiclient/multi_client.h"
+#include "multiclient/request.h"
+#include "td/utils/logging.h"
+
+// Sends the same masterchain info query through `TonlibClient::make_request` and through the callback path that
+// `RequestFunction` uses, to show what `MultiClient::send` saves by picking the former whenever it can. An account
+// state query, which `kNeedsCallbackDispatch` keeps on the callback path, is sent both through `MultiClient::send`
+// and through `RequestFunction` to show that `send` costs nothing extra there.
+int main(int argc, char* argv[]) {
+  static constexpr size_t kThreads = 16;
+  static constexpr size_t kRequestsPerThread = 500;
+  static constexpr const char* kDefaultAccount = "-1:3333333333333333333333333333333333333333333333333333333333333333";
+
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <global-config.json> [account-address]" << std::endl;
+    return 1;
+  }
+  std::string account = argc > 2 ? argv[2] : kDefaultAccount;
+
+  multiclient::MultiClient client(multiclient::MultiClientConfig{
+      .global_config_path = std::filesystem::path(argv[1]),
+      .scheduler_threads = 4,
+  });
+
+  sleep(5);
+
+  auto run_bench = [&](const std::string& name, const std::function<bool()>& send) {
+    std::atomic<size_t> failed = 0;
+    auto started_at = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreads; i++) {
+      threads.emplace_back([&]() {
+        for (size_t j = 0; j < kRequestsPerThread; j++) {
+          if (!send()) {
+            failed++;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+    auto total = kThreads * kRequestsPerThread;
+    LOG(INFO) << name << ": " << total << " requests in " << elapsed << "s, " << total / elapsed
+              << " rps, failed: " << failed.load();
+  };
+
+  run_bench("make_request", [&]() {
+    return client
+        .send(multiclient::Request<ton::tonlib_api::blocks_getMasterchainInfo>{
+            .parameters = {.mode = multiclient::RequestMode::Single},
+            .request_creator = []() { return ton::tonlib_api::blocks_getMasterchainInfo(); },
+        })
+        .is_ok();
+  });
+
+  run_bench("callback", [&]() {
+    return client
+        .send_request_function(multiclient::RequestFunction<ton::tonlib_api::blocks_getMasterchainInfo>{
+            .parameters = {.mode = multiclient::RequestMode::Single},
+            .request_creator =
+                []() { return ton::tonlib_api::make_object<ton::tonlib_api::blocks_getMasterchainInfo>(); },
+        })
+        .is_ok();
+  });
+
+  run_bench("send raw_getAccountState", [&]() {
+    return client
+        .send(multiclient::Request<ton::tonlib_api::raw_getAccountState>{
+            .parameters = {.mode = multiclient::RequestMode::Single},
+            .request_creator =
+                [&]() {
+                  return ton::tonlib_api::raw_getAccountState(
+                      ton::tonlib_api::make_object<ton::tonlib_api::accountAddress>(account)
+                  );
+                },
+        })
+        .is_ok();
+  });
+
+  run_bench("callback raw_getAccountState", [&]() {
+    return client
+        .send_request_function(multiclient::RequestFunction<ton::tonlib_api::raw_getAccountState>{
+            .parameters = {.mode = multiclient::RequestMode::Single},
+            .request_creator =
+                [&]() {
+                  return ton::tonlib_api::make_object<ton::tonlib_api::raw_getAccountState>(
+                      ton::tonlib_api::make_object<ton::tonlib_api::accountAddress>(account)
+                  );
+                },
+        })
+        .is_ok();
+  });
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "multiclient/global_config.h"
+#include "td/utils/logging.h"
+
+namespace {
+
+std::vector<multiclient::LiteServerConfig> make_lite_servers(size_t count) {
+  std::vector<multiclient::LiteServerConfig> result;
+  result.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    result.push_back(multiclient::LiteServerConfig{
+        .ip = static_cast<int32_t>(0x7f000001 + i),
+        .port = static_cast<int32_t>(10000 + i),
+        .key = "n4VDnSCUuSpjnCyUk9e3QOOd6o0ItSWYbTnW3Wnn8wk=",
+    });
+  }
+  return result;
+}
+
+std::string make_global_config(const std::vector<multiclient::LiteServerConfig>& lite_servers) {
+  static constexpr size_t kDhtNodes = 64;
+  static constexpr const char* kDhtNode =
+      R"({"@type":"dht.node","id":{"@type":"pub.ed25519","key":"n4VDnSCUuSpjnCyUk9e3QOOd6o0ItSWYbTnW3Wnn8wk="},)"
+      R"("addr_list":{"@type":"adnl.addressList","addrs":[{"@type":"adnl.address.udp","ip":1,"port":6302}],)"
+      R"("version":0,"reinit_date":0,"priority":0,"expire_at":0},"version":-1,)"
+      R"("signature":"6XYfa3ZcdsHZvXUiIv1EAINBQyG5BHOS0kT6bTGkvmvlLhKGRDI9XAhGq0qMh7kB"})";
+
+  // A dht section of realistic size, so that copying it for every lite server shows up in the numbers.
+  std::string result = R"({"@type":"config.global","dht":{"@type":"dht.config.global","k":6,"a":3,)";
+  result += R"("static_nodes":{"@type":"dht.nodes","nodes":[)";
+  for (size_t i = 0; i < kDhtNodes; i++) {
+    result += i == 0 ? "" : ",";
+    result += kDhtNode;
+  }
+  result += R"(]}},"liteservers":[)";
+  for (size_t i = 0; i < lite_servers.size(); i++) {
+    const auto& lite_server = lite_servers[i];
+    result += i == 0 ? "" : ",";
+    result += R"({"ip":)" + std::to_string(lite_server.ip) + R"(,"port":)" + std::to_string(lite_server.port);
+    result += R"(,"id":{"@type":"pub.ed25519","key":")" + lite_server.key + R"("}})";
+  }
+  result += R"(],"validator":{"@type":"validator.config.global","zero_state":{"workchain":-1,)";
+  result += R"("shard":-9223372036854775808,"seqno":0,"root_hash":"F6OpKZKqvqeFp6CQmFomXNMfMj2EnaUSOXN+Mh+wVWk=",)";
+  result += R"("file_hash":"XplPz01CXAps5qeSWUtxcyBfdAo5zVb1N979KLSKD24="}}})";
+  return result;
+}
+
+}  // namespace
+
+// Splits a generated global config with 500 lite servers, the way every start does, both from the config's own
+// `liteservers` list and from a structured list.
+int main() {
+  static constexpr size_t kLiteServers = 500;
+  static constexpr size_t kIterations = 20;
+
+  auto lite_servers = make_lite_servers(kLiteServers);
+  auto global_config = make_global_config(lite_servers);
+
+  auto run_bench = [&](const std::string& name, const std::vector<multiclient::LiteServerConfig>& list) {
+    size_t bytes = 0;
+    auto started_at = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; i++) {
+      auto result = multiclient::split_global_config(global_config, list);
+      if (result.is_error()) {
+        LOG(ERROR) << name << ": " << result.error();
+        return;
+      }
+      for (const auto& config : result.ok()) {
+        bytes += config.size();
+      }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+    LOG(INFO) << name << ": " << kLiteServers << " lite servers, " << global_config.size() << " bytes config, "
+              << elapsed / kIterations * 1000 << "ms per split, " << bytes / kIterations << " bytes produced";
+  };
+
+  run_bench("config liteservers", {});
+  run_bench("structured liteservers", lite_servers);
+
+  return 0;
+}
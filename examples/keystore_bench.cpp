@@ -0,0 +1,124 @@
+#include <unistd.h>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include "auto/tl/tonlib_api.h"
+#include "multiclient/multi_client.h"
+#include "multiclient/request.h"
+#include "td/utils/SharedSlice.h"
+#include "td/utils/logging.h"
+
+namespace {
+
+size_t directory_size(const std::filesystem::path& path) {
+  size_t result = 0;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+    if (entry.is_regular_file(ec)) {
+      result += entry.file_size(ec);
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+// Starts a client for every lite server of the config with per-worker and with shared keystores and reports the time
+// until all workers are alive, the size of the keystore on disk and how many workers write to it. It then creates a key
+// and exports it repeatedly with `RequestMode::Single`: with per-worker keystores only the worker that created the key
+// knows it, while the shared keystore routes every export to its owner.
+int main(int argc, char* argv[]) {
+  static constexpr double kStartTimeout = 120.0;
+  static constexpr size_t kExports = 20;
+
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <global-config.json> <keystore-dir>" << std::endl;
+    return 1;
+  }
+
+  auto run_bench = [&](const std::string& name, multiclient::KeyStoreMode mode) {
+    auto key_store_root = std::filesystem::path(argv[2]) / name;
+    std::filesystem::remove_all(key_store_root);
+    std::filesystem::create_directories(key_store_root);
+
+    auto started_at = std::chrono::steady_clock::now();
+    multiclient::MultiClient client(multiclient::MultiClientConfig{
+        .global_config_path = std::filesystem::path(argv[1]),
+        .key_store_root = key_store_root,
+        .key_store_mode = mode,
+        .scheduler_threads = 4,
+    });
+
+    size_t alive = 0;
+    size_t total = 0;
+    double elapsed = 0;
+    while (elapsed < kStartTimeout) {
+      usleep(100 * 1000);
+      elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+
+      auto stats = client.get_worker_stats();
+      if (stats.is_error()) {
+        continue;
+      }
+      total = stats.ok().size();
+      alive = 0;
+      for (const auto& worker : stats.ok()) {
+        alive += worker.is_alive;
+      }
+      if (total > 0 && alive == total) {
+        break;
+      }
+    }
+
+    size_t writers = total;
+    if (mode == multiclient::KeyStoreMode::Shared) {
+      writers = 0;
+      auto stats = client.get_worker_stats();
+      if (stats.is_ok()) {
+        for (const auto& worker : stats.ok()) {
+          writers += worker.owns_key_store;
+        }
+      }
+    }
+
+    size_t exported = 0;
+    auto key = client.send(multiclient::Request<ton::tonlib_api::createNewKey>{
+        .parameters = {.mode = multiclient::RequestMode::Single},
+        .request_creator =
+            []() {
+              return ton::tonlib_api::createNewKey(td::SecureString("local"), td::SecureString(), td::SecureString());
+            },
+    });
+    if (key.is_error()) {
+      LOG(ERROR) << name << ": failed to create a key: " << key.error();
+    } else {
+      for (size_t i = 0; i < kExports; i++) {
+        auto result = client.send(multiclient::Request<ton::tonlib_api::exportKey>{
+            .parameters = {.mode = multiclient::RequestMode::Single},
+            .request_creator =
+                [&]() {
+                  return ton::tonlib_api::exportKey(ton::tonlib_api::make_object<ton::tonlib_api::inputKeyRegular>(
+                      ton::tonlib_api::make_object<ton::tonlib_api::key>(
+                          key.ok()->public_key_, key.ok()->secret_.copy()
+                      ),
+                      td::SecureString("local")
+                  ));
+                },
+        });
+        exported += result.is_ok();
+      }
+    }
+
+    LOG(INFO) << name << ": " << alive << "/" << total << " workers alive after " << elapsed
+              << "s, keystore size: " << directory_size(key_store_root) << " bytes, " << writers
+              << " workers writing it, " << exported << "/" << kExports << " exports of a new key succeeded";
+  };
+
+  run_bench("per_worker", multiclient::KeyStoreMode::PerWorker);
+  run_bench("shared", multiclient::KeyStoreMode::Shared);
+
+  return 0;
+}
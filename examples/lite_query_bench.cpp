@@ -0,0 +1,76 @@
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "auto/tl/lite_api.h"
+#include "auto/tl/tonlib_api.h"
+#include "multiclient/multi_client.h"
+#include "multiclient/request.h"
+#include "td/utils/logging.h"
+
+// Sends the same masterchain info query through `TonlibClient` and over the direct lite_api connections.
+int main(int argc, char* argv[]) {
+  static constexpr size_t kThreads = 16;
+  static constexpr size_t kRequestsPerThread = 500;
+
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <global-config.json>" << std::endl;
+    return 1;
+  }
+
+  multiclient::MultiClient client(multiclient::MultiClientConfig{
+      .global_config_path = std::filesystem::path(argv[1]),
+      .scheduler_threads = 4,
+      .direct_lite_server_queries = true,
+  });
+
+  sleep(5);
+
+  auto run_bench = [&](const std::string& name, const std::function<bool()>& send) {
+    std::atomic<size_t> failed = 0;
+    auto started_at = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kThreads; i++) {
+      threads.emplace_back([&]() {
+        for (size_t j = 0; j < kRequestsPerThread; j++) {
+          if (!send()) {
+            failed++;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+    auto total = kThreads * kRequestsPerThread;
+    LOG(INFO) << name << ": " << total << " requests in " << elapsed << "s, " << total / elapsed
+              << " rps, failed: " << failed.load();
+  };
+
+  run_bench("tonlib", [&]() {
+    return client
+        .send_request(multiclient::Request<ton::tonlib_api::blocks_getMasterchainInfo>{
+            .parameters = {.mode = multiclient::RequestMode::Single},
+            .request_creator = []() { return ton::tonlib_api::blocks_getMasterchainInfo(); },
+        })
+        .is_ok();
+  });
+
+  run_bench("lite_api", [&]() {
+    return client
+        .send_lite_request(multiclient::RequestLite<ton::lite_api::liteServer_getMasterchainInfo>{
+            .parameters = {.mode = multiclient::RequestMode::Single},
+            .request_creator = []() { return ton::lite_api::liteServer_getMasterchainInfo(); },
+        })
+        .is_ok();
+  });
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <unistd.h>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include "auto/tl/tonlib_api.h"
+#include "multiclient/code_cache.h"
+#include "multiclient/local_get_method.h"
+#include "multiclient/multi_client.h"
+#include "multiclient/request.h"
+#include "td/utils/logging.h"
+
+// Runs `get_wallet_data` for a batch of 10k jetton wallets sharing the same code, once deserializing the code for
+// every account and once through the shared code cache. All wallets use the state of the wallet given on the command
+// line.
+int main(int argc, char* argv[]) {
+  static constexpr size_t kBatchSize = 10000;
+
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <global-config.json> <jetton-wallet-address>" << std::endl;
+    return 1;
+  }
+  const std::string address = argv[2];
+
+  multiclient::MultiClient client(multiclient::MultiClientConfig{
+      .global_config_path = std::filesystem::path(argv[1]),
+      .scheduler_threads = 2,
+  });
+
+  sleep(5);
+
+  auto account_state = client.send_request_function(multiclient::RequestFunction<ton::tonlib_api::raw_getAccountState>{
+      .parameters = {.mode = multiclient::RequestMode::Single},
+      .request_creator =
+          [&]() {
+            return ton::tonlib_api::make_object<ton::tonlib_api::raw_getAccountState>(
+                ton::tonlib_api::make_object<ton::tonlib_api::accountAddress>(address)
+            );
+          },
+  });
+  if (account_state.is_error()) {
+    LOG(ERROR) << "failed to get account state: " << account_state.error();
+    return 1;
+  }
+  auto state = account_state.move_as_ok();
+
+  // Jetton wallets are often deployed as library cells, resolve them once before measuring.
+  multiclient::CodeCache code_cache(64 << 20);
+  auto local_state = multiclient::make_local_account_state(address, *state, &code_cache).move_as_ok();
+  while (true) {
+    auto result = multiclient::run_get_method_locally(*local_state, nullptr, std::string("get_wallet_data"), {});
+    if (result.is_error()) {
+      LOG(ERROR) << "get_wallet_data failed: " << result.error();
+      return 1;
+    }
+    if (!result.ok().missing_library.has_value()) {
+      break;
+    }
+
+    auto library_hash = *result.ok().missing_library;
+    auto libraries = client.send_request_function(multiclient::RequestFunction<ton::tonlib_api::smc_getLibraries>{
+        .parameters = {.mode = multiclient::RequestMode::Single},
+        .request_creator =
+            [&]() {
+              return ton::tonlib_api::make_object<ton::tonlib_api::smc_getLibraries>(
+                  std::vector<td::Bits256>{library_hash}
+              );
+            },
+    });
+    if (libraries.is_error() || libraries.ok()->result_.empty()) {
+      LOG(ERROR) << "failed to load library " << library_hash.to_hex();
+      return 1;
+    }
+    auto library = code_cache.add_library(library_hash, libraries.ok()->result_[0]->data_).move_as_ok();
+    auto updated_state = std::make_shared<multiclient::LocalAccountState>(*local_state);
+    updated_state->code = code_cache.add_code_library(local_state->code, library_hash, library);
+    local_state = std::move(updated_state);
+  }
+  auto libraries = local_state->code->libraries;
+
+  auto run_batch = [&](const std::string& name, multiclient::CodeCache* cache) {
+    auto started_at = std::chrono::steady_clock::now();
+    size_t failed = 0;
+    for (size_t i = 0; i < kBatchSize; i++) {
+      auto batch_state = multiclient::make_local_account_state(address, *state, cache).move_as_ok();
+      if (cache == nullptr) {
+        auto with_libraries = std::make_shared<multiclient::LocalAccountState>(*batch_state);
+        auto code = std::make_shared<multiclient::CodeCache::Code>(*batch_state->code);
+        code->libraries = libraries;
+        with_libraries->code = std::move(code);
+        batch_state = std::move(with_libraries);
+      }
+
+      auto result = multiclient::run_get_method_locally(*batch_state, nullptr, std::string("get_wallet_data"), {});
+      if (result.is_error() || result.ok().result == nullptr || result.ok().result->exit_code_ != 0) {
+        failed++;
+      }
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_at).count();
+    LOG(INFO) << name << ": " << kBatchSize << " runs in " << elapsed << "s, " << kBatchSize / elapsed
+              << " runs/s, failed: " << failed;
+  };
+
+  run_batch("without code cache", nullptr);
+  run_batch("with code cache", &code_cache);
+
+  auto stats = code_cache.stats();
+  LOG(INFO) << "code cache: " << stats.code_entries << " code entries, " << stats.library_entries
+            << " library entries, " << stats.size_bytes << " bytes, hits: " << stats.hits
+            << " misses: " << stats.misses;
+
+  return 0;
+}
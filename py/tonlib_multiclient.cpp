@@ -49,6 +49,14 @@ PYBIND11_MODULE(tonlib_multiclient, m) {
       .value("Single", multiclient::RequestMode::Single)
       .value("Broadcast", multiclient::RequestMode::Broadcast)
       .value("Multiple", multiclient::RequestMode::Multiple)
+      .value("Gather", multiclient::RequestMode::Gather)
+      .value("Freshest", multiclient::RequestMode::Freshest)
+      .value("FirstK", multiclient::RequestMode::FirstK)
+      .export_values();
+
+  py::enum_<multiclient::RoutingPolicy>(m, "RoutingPolicy")
+      .value("LeastLoaded", multiclient::RoutingPolicy::LeastLoaded)
+      .value("BestForMethod", multiclient::RoutingPolicy::BestForMethod)
       .export_values();
 
   py::class_<multiclient::RequestParameters>(m, "RequestParameters")
@@ -56,23 +64,47 @@ PYBIND11_MODULE(tonlib_multiclient, m) {
           py::init([](multiclient::RequestMode mode,
                       std::optional<std::vector<size_t>> lite_server_indexes,
                       std::optional<size_t> clients_number,
-                      bool archival) {
+                      bool archival,
+                      std::optional<int32_t> min_mc_seqno,
+                      bool prefer_archival,
+                      std::optional<double> min_mc_seqno_wait,
+                      multiclient::RoutingPolicy routing,
+                      std::optional<double> timeout,
+                      double freshness_window) {
             return multiclient::RequestParameters{
                 .mode = mode,
                 .lite_server_indexes = std::move(lite_server_indexes),
                 .clients_number = clients_number,
                 .archival = archival,
+                .prefer_archival = prefer_archival,
+                .min_mc_seqno = min_mc_seqno,
+                .min_mc_seqno_wait = min_mc_seqno_wait,
+                .routing = routing,
+                .timeout = timeout,
+                .freshness_window = freshness_window,
             };
           }),
           py::arg("mode") = multiclient::RequestMode::Broadcast,
           py::arg("lite_server_indexes") = std::nullopt,
           py::arg("clients_number") = std::nullopt,
-          py::arg("archival") = false
+          py::arg("archival") = false,
+          py::arg("min_mc_seqno") = std::nullopt,
+          py::arg("prefer_archival") = false,
+          py::arg("min_mc_seqno_wait") = std::nullopt,
+          py::arg("routing") = multiclient::RoutingPolicy::LeastLoaded,
+          py::arg("timeout") = std::nullopt,
+          py::arg("freshness_window") = 0.2
       )
       .def_readwrite("mode", &multiclient::RequestParameters::mode)
       .def_readwrite("lite_server_indexes", &multiclient::RequestParameters::lite_server_indexes)
       .def_readwrite("clients_number", &multiclient::RequestParameters::clients_number)
-      .def_readwrite("archival", &multiclient::RequestParameters::archival);
+      .def_readwrite("archival", &multiclient::RequestParameters::archival)
+      .def_readwrite("prefer_archival", &multiclient::RequestParameters::prefer_archival)
+      .def_readwrite("min_mc_seqno", &multiclient::RequestParameters::min_mc_seqno)
+      .def_readwrite("min_mc_seqno_wait", &multiclient::RequestParameters::min_mc_seqno_wait)
+      .def_readwrite("routing", &multiclient::RequestParameters::routing)
+      .def_readwrite("timeout", &multiclient::RequestParameters::timeout)
+      .def_readwrite("freshness_window", &multiclient::RequestParameters::freshness_window);
 
   py::class_<multiclient::RequestJson>(m, "RequestJson")
       .def(
@@ -0,0 +1,94 @@
+#include "account_watcher.h"
+#include <utility>
+#include "block/block.h"
+#include "td/utils/logging.h"
+
+namespace multiclient {
+
+td::Status AccountWatchSet::add(const std::vector<std::string>& addresses) {
+  std::vector<std::pair<std::string, std::string>> parsed;
+  parsed.reserve(addresses.size());
+
+  for (const auto& address : addresses) {
+    auto std_address = block::StdAddress::parse(address);
+    if (std_address.is_error()) {
+      return td::Status::Error("Invalid account address: " + address);
+    }
+    parsed.emplace_back(make_key(std_address.ok().workchain, std_address.ok().addr.as_slice()), address);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& [key, address] : parsed) {
+    accounts_.insert_or_assign(std::move(key), std::move(address));
+  }
+  return td::Status::OK();
+}
+
+void AccountWatchSet::remove(const std::vector<std::string>& addresses) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& address : addresses) {
+    auto std_address = block::StdAddress::parse(address);
+    if (std_address.is_ok()) {
+      accounts_.erase(make_key(std_address.ok().workchain, std_address.ok().addr.as_slice()));
+    }
+  }
+}
+
+size_t AccountWatchSet::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return accounts_.size();
+}
+
+std::vector<AccountChange> AccountWatchSet::extract_changes(ScannedBlock& block) const {
+  std::vector<AccountChange> changes;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& shard_block : block.blocks) {
+    std::unordered_map<std::string, size_t> change_index;
+    for (auto& tx : shard_block.transactions) {
+      auto key = make_key(shard_block.block_id->workchain_, tx->account_);
+      auto account_it = accounts_.find(key);
+      if (account_it == accounts_.end()) {
+        continue;
+      }
+
+      auto [it, inserted] = change_index.emplace(std::move(key), changes.size());
+      if (inserted) {
+        changes.push_back(AccountChange{
+            .address = account_it->second,
+            .block_id = ton::tonlib_api::make_object<ton::tonlib_api::ton_blockIdExt>(*shard_block.block_id),
+        });
+      }
+      changes[it->second].transactions.push_back(std::move(tx));
+    }
+  }
+  return changes;
+}
+
+std::string AccountWatchSet::make_key(int32_t workchain, td::Slice account) {
+  return std::to_string(workchain) + ":" + account.str();
+}
+
+AccountWatcher::AccountWatcher(
+    std::shared_ptr<AccountWatchSet> watch_set, std::unique_ptr<AccountWatchCallback> callback
+) :
+    watch_set_(std::move(watch_set)), callback_(std::move(callback)) {
+}
+
+void AccountWatcher::on_block(ScannedBlock block) {
+  auto changes = watch_set_->extract_changes(block);
+  if (!changes.empty()) {
+    callback_->on_changes(block.mc_seqno, std::move(changes));
+  }
+}
+
+void AccountWatcher::on_finished(td::Status status) {
+  if (status.is_ok()) {
+    LOG(INFO) << "account watch finished";
+  } else {
+    LOG(WARNING) << "account watch stopped: " << status;
+  }
+  callback_->on_finished(std::move(status));
+}
+
+}  // namespace multiclient
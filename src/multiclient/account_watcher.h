@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "auto/tl/tonlib_api.h"
+#include "block_scanner.h"
+#include "td/utils/Slice.h"
+#include "td/utils/Status.h"
+
+namespace multiclient {
+
+struct AccountWatchConfig {
+  std::vector<std::string> addresses;
+  std::optional<int32_t> from_seqno = std::nullopt;
+  size_t parallelism = 4;
+  std::optional<std::filesystem::path> checkpoint_path = std::nullopt;
+};
+
+struct AccountChange {
+  // Address exactly as it was added to the watch set.
+  std::string address;
+  ton::tonlib_api::object_ptr<ton::tonlib_api::ton_blockIdExt> block_id;
+  std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::blocks_shortTxId>> transactions;
+};
+
+class AccountWatchCallback {
+public:
+  virtual void on_changes(int32_t mc_seqno, std::vector<AccountChange> changes) = 0;
+  // Called once when the watch ends: with an error if it failed or was stopped by `stop_account_watch`.
+  virtual void on_finished(td::Status status) {
+  }
+  virtual ~AccountWatchCallback() = default;
+};
+
+class AccountWatchSet {
+public:
+  td::Status add(const std::vector<std::string>& addresses);
+  void remove(const std::vector<std::string>& addresses);
+
+  size_t size() const;
+
+  // Moves transactions of watched accounts out of `block`, grouped by account and shard block.
+  std::vector<AccountChange> extract_changes(ScannedBlock& block) const;
+
+private:
+  static std::string make_key(int32_t workchain, td::Slice account);
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::string> accounts_;
+};
+
+// Turns followed blocks into per-account change notifications: every transaction id of every shard block is matched
+// against the watch set, so the lite server load depends on chain activity and not on the number of watched accounts.
+class AccountWatcher : public BlockScanCallback {
+public:
+  AccountWatcher(std::shared_ptr<AccountWatchSet> watch_set, std::unique_ptr<AccountWatchCallback> callback);
+
+  void on_block(ScannedBlock block) final;
+  void on_finished(td::Status status) final;
+
+private:
+  std::shared_ptr<AccountWatchSet> watch_set_;
+  std::unique_ptr<AccountWatchCallback> callback_;
+};
+
+}  // namespace multiclient
@@ -0,0 +1,508 @@
+#include "block_scanner.h"
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <utility>
+#include "auto/tl/tonlib_api.h"
+#include "multi_client_actor.h"
+#include "request.h"
+#include "td/actor/PromiseFuture.h"
+#include "td/actor/actor.h"
+#include "td/utils/filesystem.h"
+#include "td/utils/Time.h"
+#include "td/utils/misc.h"
+
+namespace multiclient {
+
+BlockScanner::BlockScanner(
+    uint64_t scan_id,
+    td::actor::ActorId<MultiClientActor> router,
+    BlockScanConfig config,
+    std::unique_ptr<BlockScanCallback> callback
+) :
+    scan_id_(scan_id),
+    router_(std::move(router)),
+    config_(std::move(config)),
+    follow_head_(false),
+    callback_(std::move(callback)) {
+}
+
+BlockScanner::BlockScanner(
+    uint64_t scan_id,
+    td::actor::ActorId<MultiClientActor> router,
+    BlockFollowConfig config,
+    std::unique_ptr<BlockScanCallback> callback
+) :
+    scan_id_(scan_id),
+    router_(std::move(router)),
+    config_(BlockScanConfig{
+        .from_seqno = config.from_seqno.value_or(0),
+        .to_seqno = std::numeric_limits<int32_t>::max(),
+        .parallelism = config.parallelism,
+        .in_order = true,
+        .checkpoint_path = std::move(config.checkpoint_path),
+        .transactions_page_size = config.transactions_page_size,
+        .max_retries = std::numeric_limits<size_t>::max(),
+        .with_shards = config.with_shards,
+        .with_transactions = config.with_transactions,
+    }),
+    follow_head_(true),
+    callback_(std::move(callback)),
+    start_at_head_(!config.from_seqno.has_value()) {
+}
+
+void BlockScanner::start_up() {
+  static constexpr double kCheckpointFlushInterval = 1.0;
+
+  next_seqno_ = config_.from_seqno;
+  load_checkpoint();
+  next_undelivered_seqno_ = next_seqno_;
+
+  if (config_.checkpoint_path.has_value()) {
+    next_checkpoint_flush_ = td::Timestamp::in(kCheckpointFlushInterval);
+    alarm_timestamp() = next_checkpoint_flush_;
+  }
+
+  if (start_at_head_) {
+    LOG(INFO) << "block scan #" << scan_id_ << " started from the cluster head";
+    wait_for_head();
+    return;
+  }
+
+  LOG(INFO) << "block scan #" << scan_id_ << " started from " << next_seqno_;
+  schedule_blocks();
+}
+
+void BlockScanner::alarm() {
+  static constexpr double kCheckpointFlushInterval = 1.0;
+
+  while (!finished_ && !delayed_steps_.empty() && delayed_steps_.begin()->first <= td::Time::now()) {
+    auto step = std::move(delayed_steps_.begin()->second);
+    delayed_steps_.erase(delayed_steps_.begin());
+    step();
+  }
+
+  if (config_.checkpoint_path.has_value() && next_checkpoint_flush_.is_in_past()) {
+    flush_checkpoint();
+    next_checkpoint_flush_ = td::Timestamp::in(kCheckpointFlushInterval);
+  }
+
+  alarm_timestamp() = next_checkpoint_flush_;
+  if (!delayed_steps_.empty()) {
+    alarm_timestamp().relax(td::Timestamp::at(delayed_steps_.begin()->first));
+  }
+}
+
+void BlockScanner::tear_down() {
+  // Destroyed by `MultiClient::stop_block_scan` or with the router before the range was done.
+  finish(td::Status::Error("block scan stopped"));
+}
+
+void BlockScanner::schedule_blocks() {
+  auto last_seqno = follow_head_ ? std::min(config_.to_seqno, known_head_) : config_.to_seqno;
+  while (!finished_ && next_seqno_ <= last_seqno &&
+         static_cast<size_t>(next_seqno_ - next_undelivered_seqno_) < config_.parallelism) {
+    auto mc_seqno = next_seqno_++;
+    auto& state = in_flight_[mc_seqno];
+    state.result.mc_seqno = mc_seqno;
+    state.pending_steps = 1;
+    lookup_block(mc_seqno, 0);
+  }
+
+  if (finished_) {
+    return;
+  }
+
+  if (in_flight_.empty() && ready_.empty() && next_undelivered_seqno_ > config_.to_seqno) {
+    finish(td::Status::OK());
+    return;
+  }
+
+  if (follow_head_ && next_seqno_ > known_head_) {
+    wait_for_head();
+  }
+}
+
+void BlockScanner::wait_for_head() {
+  if (waiting_for_head_) {
+    return;
+  }
+  waiting_for_head_ = true;
+
+  auto seqno = start_at_head_ ? 0 : next_seqno_;
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::wait_for_mc_seqno,
+      seqno,
+      td::Promise<int32_t>([self_id = actor_id(this)](td::Result<int32_t> head) {
+        td::actor::send_closure(self_id, &BlockScanner::on_head, std::move(head));
+      })
+  );
+}
+
+void BlockScanner::on_head(td::Result<int32_t> head) {
+  waiting_for_head_ = false;
+  if (head.is_error()) {
+    LOG(WARNING) << "block scan #" << scan_id_ << " failed to wait for the cluster head: " << head.error();
+    return;
+  }
+
+  known_head_ = std::max(known_head_, head.ok());
+  if (start_at_head_) {
+    start_at_head_ = false;
+    next_seqno_ = known_head_;
+    next_undelivered_seqno_ = known_head_;
+    LOG(INFO) << "block scan #" << scan_id_ << " following from " << known_head_;
+  }
+  schedule_blocks();
+}
+
+void BlockScanner::lookup_block(int32_t mc_seqno, size_t attempt) {
+  static constexpr int32_t kLookupBySeqno = 1;
+  static constexpr int64_t kLookupLt = 0;
+  static constexpr int32_t kLookupUtime = 0;
+
+  auto promise = td::Promise<tonlib_api::blocks_lookupBlock::ReturnType>(
+      [self_id = actor_id(this), mc_seqno, attempt](auto result) {
+        td::actor::send_closure(self_id, &BlockScanner::on_block_looked_up, mc_seqno, attempt, std::move(result));
+      }
+  );
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::send_request<tonlib_api::blocks_lookupBlock>,
+      Request<tonlib_api::blocks_lookupBlock>{
+          .parameters = step_parameters(mc_seqno, attempt),
+          .request_creator =
+              [mc_seqno]() {
+                return tonlib_api::blocks_lookupBlock(
+                    kLookupBySeqno,
+                    tonlib_api::make_object<tonlib_api::ton_blockId>(ton::masterchainId, ton::shardIdAll, mc_seqno),
+                    kLookupLt,
+                    kLookupUtime
+                );
+              },
+      },
+      std::move(promise)
+  );
+}
+
+void BlockScanner::on_block_looked_up(
+    int32_t mc_seqno, size_t attempt, td::Result<tonlib_api::object_ptr<tonlib_api::ton_blockIdExt>> result
+) {
+  if (finished_) {
+    return;
+  }
+
+  if (result.is_error()) {
+    retry_step(mc_seqno, attempt, result.error(), [this, mc_seqno, attempt]() {
+      lookup_block(mc_seqno, attempt + 1);
+    });
+    return;
+  }
+
+  auto mc_block_id = *result.move_as_ok();
+  auto& state = in_flight_[mc_seqno];
+  state.result.blocks.push_back(ScannedShardBlock{
+      .block_id = tonlib_api::make_object<tonlib_api::ton_blockIdExt>(mc_block_id),
+  });
+  if (config_.with_shards) {
+    state.pending_steps++;
+    get_shards(mc_seqno, mc_block_id, 0);
+  }
+  if (config_.with_transactions) {
+    state.pending_steps++;
+    get_transactions(mc_seqno, 0, mc_block_id, std::nullopt, 0);
+  }
+  on_step_done(mc_seqno);
+}
+
+void BlockScanner::get_shards(int32_t mc_seqno, tonlib_api::ton_blockIdExt mc_block_id, size_t attempt) {
+  auto promise = td::Promise<tonlib_api::blocks_getShards::ReturnType>(
+      [self_id = actor_id(this), mc_seqno, mc_block_id, attempt](auto result) mutable {
+        td::actor::send_closure(
+            self_id, &BlockScanner::on_shards, mc_seqno, std::move(mc_block_id), attempt, std::move(result)
+        );
+      }
+  );
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::send_request<tonlib_api::blocks_getShards>,
+      Request<tonlib_api::blocks_getShards>{
+          .parameters = step_parameters(mc_seqno, attempt),
+          .request_creator =
+              [mc_block_id]() {
+                return tonlib_api::blocks_getShards(tonlib_api::make_object<tonlib_api::ton_blockIdExt>(mc_block_id));
+              },
+      },
+      std::move(promise)
+  );
+}
+
+void BlockScanner::on_shards(
+    int32_t mc_seqno,
+    tonlib_api::ton_blockIdExt mc_block_id,
+    size_t attempt,
+    td::Result<tonlib_api::object_ptr<tonlib_api::blocks_shards>> result
+) {
+  if (finished_) {
+    return;
+  }
+
+  if (result.is_error()) {
+    retry_step(mc_seqno, attempt, result.error(), [this, mc_seqno, mc_block_id, attempt]() {
+      get_shards(mc_seqno, mc_block_id, attempt + 1);
+    });
+    return;
+  }
+
+  auto shards = result.move_as_ok();
+  auto& state = in_flight_[mc_seqno];
+  for (auto& shard : shards->shards_) {
+    auto block_index = state.result.blocks.size();
+    auto shard_block_id = *shard;
+    state.result.blocks.push_back(ScannedShardBlock{.block_id = std::move(shard)});
+    if (config_.with_transactions) {
+      state.pending_steps++;
+      get_transactions(mc_seqno, block_index, std::move(shard_block_id), std::nullopt, 0);
+    }
+  }
+  on_step_done(mc_seqno);
+}
+
+void BlockScanner::get_transactions(
+    int32_t mc_seqno,
+    size_t block_index,
+    tonlib_api::ton_blockIdExt block_id,
+    std::optional<tonlib_api::blocks_accountTransactionId> after,
+    size_t attempt
+) {
+  static constexpr int32_t kTxIdFieldsMode = 1 | 2 | 4;
+  static constexpr int32_t kAfterMode = 128;
+
+  auto promise = td::Promise<tonlib_api::blocks_getTransactions::ReturnType>(
+      [self_id = actor_id(this), mc_seqno, block_index, block_id, after, attempt](auto result) mutable {
+        td::actor::send_closure(
+            self_id,
+            &BlockScanner::on_transactions,
+            mc_seqno,
+            block_index,
+            std::move(block_id),
+            std::move(after),
+            attempt,
+            std::move(result)
+        );
+      }
+  );
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::send_request<tonlib_api::blocks_getTransactions>,
+      Request<tonlib_api::blocks_getTransactions>{
+          .parameters = step_parameters(mc_seqno, attempt),
+          .request_creator =
+              [block_id, after, count = config_.transactions_page_size]() {
+                return tonlib_api::blocks_getTransactions(
+                    tonlib_api::make_object<tonlib_api::ton_blockIdExt>(block_id),
+                    after.has_value() ? kTxIdFieldsMode | kAfterMode : kTxIdFieldsMode,
+                    count,
+                    after.has_value() ? tonlib_api::make_object<tonlib_api::blocks_accountTransactionId>(*after) :
+                                        tonlib_api::make_object<tonlib_api::blocks_accountTransactionId>()
+                );
+              },
+      },
+      std::move(promise)
+  );
+}
+
+void BlockScanner::on_transactions(
+    int32_t mc_seqno,
+    size_t block_index,
+    tonlib_api::ton_blockIdExt block_id,
+    std::optional<tonlib_api::blocks_accountTransactionId> after,
+    size_t attempt,
+    td::Result<tonlib_api::object_ptr<tonlib_api::blocks_transactions>> result
+) {
+  if (finished_) {
+    return;
+  }
+
+  if (result.is_error()) {
+    retry_step(mc_seqno, attempt, result.error(), [this, mc_seqno, block_index, block_id, after, attempt]() {
+      get_transactions(mc_seqno, block_index, block_id, after, attempt + 1);
+    });
+    return;
+  }
+
+  auto transactions = result.move_as_ok();
+  auto& block = in_flight_[mc_seqno].result.blocks[block_index];
+  for (auto& tx : transactions->transactions_) {
+    block.transactions.push_back(std::move(tx));
+  }
+
+  if (transactions->incomplete_ && !block.transactions.empty()) {
+    const auto& last_tx = *block.transactions.back();
+    get_transactions(
+        mc_seqno,
+        block_index,
+        std::move(block_id),
+        tonlib_api::blocks_accountTransactionId(last_tx.account_, last_tx.lt_),
+        0
+    );
+    return;
+  }
+
+  on_step_done(mc_seqno);
+}
+
+RequestParameters BlockScanner::step_parameters(int32_t mc_seqno, size_t attempt) const {
+  // A failed step is retried on archival workers when there are any: a regular lite server is the usual reason for a
+  // miss on old blocks, including the back-fill of a follower started far behind the head. Before the first archival
+  // check, or without archival workers, any worker is used.
+  if (follow_head_) {
+    return RequestParameters{
+        .mode = RequestMode::Single,
+        .prefer_archival = attempt > 0,
+        .min_mc_seqno = mc_seqno,
+    };
+  }
+
+  return RequestParameters{
+      .mode = RequestMode::Single,
+      .archival = config_.archival,
+      .prefer_archival = attempt > 0,
+  };
+}
+
+void BlockScanner::retry_step(
+    int32_t mc_seqno, size_t attempt, const td::Status& error, std::function<void()> step
+) {
+  static constexpr double kRetryBaseDelay = 0.1;
+  static constexpr double kRetryMaxDelay = 5.0;
+  static constexpr size_t kRetryMaxBackoffShift = 6;
+
+  if (attempt >= config_.max_retries) {
+    finish(td::Status::Error(
+        "mc block " + std::to_string(mc_seqno) + " failed after " + std::to_string(attempt + 1) +
+        " attempts: " + error.message().str()
+    ));
+    return;
+  }
+
+  LOG(DEBUG) << "block scan #" << scan_id_ << " mc block " << mc_seqno << " attempt " << attempt
+             << " failed: " << error;
+
+  auto delay = std::min(kRetryMaxDelay, kRetryBaseDelay * (1 << std::min(attempt, kRetryMaxBackoffShift)));
+  auto retry_at = td::Timestamp::in(delay);
+  delayed_steps_.emplace(retry_at.at(), std::move(step));
+  alarm_timestamp().relax(retry_at);
+}
+
+void BlockScanner::on_step_done(int32_t mc_seqno) {
+  auto it = in_flight_.find(mc_seqno);
+  CHECK(it != in_flight_.end());
+  if (--it->second.pending_steps != 0) {
+    return;
+  }
+
+  auto block = std::move(it->second.result);
+  in_flight_.erase(it);
+
+  if (config_.in_order) {
+    ready_.emplace(mc_seqno, std::move(block));
+    deliver_ready_blocks();
+  } else {
+    callback_->on_block(std::move(block));
+    mark_delivered(mc_seqno);
+  }
+
+  schedule_blocks();
+}
+
+void BlockScanner::deliver_ready_blocks() {
+  while (!ready_.empty() && ready_.begin()->first == next_undelivered_seqno_) {
+    auto block = std::move(ready_.begin()->second);
+    ready_.erase(ready_.begin());
+    callback_->on_block(std::move(block));
+    mark_delivered(next_undelivered_seqno_);
+  }
+}
+
+void BlockScanner::mark_delivered(int32_t mc_seqno) {
+  checkpoint_dirty_ = true;
+  if (mc_seqno != next_undelivered_seqno_) {
+    delivered_ahead_.insert(mc_seqno);
+    return;
+  }
+
+  next_undelivered_seqno_++;
+  while (!delivered_ahead_.empty() && *delivered_ahead_.begin() == next_undelivered_seqno_) {
+    delivered_ahead_.erase(delivered_ahead_.begin());
+    next_undelivered_seqno_++;
+  }
+}
+
+void BlockScanner::load_checkpoint() {
+  if (!config_.checkpoint_path.has_value() || !std::filesystem::exists(*config_.checkpoint_path)) {
+    return;
+  }
+
+  auto content = td::read_file_str(config_.checkpoint_path->string());
+  if (content.is_error()) {
+    LOG(WARNING) << "block scan #" << scan_id_ << " failed to read checkpoint: " << content.error();
+    return;
+  }
+
+  auto last_seqno = td::to_integer_safe<int32_t>(td::trim(content.ok()));
+  if (last_seqno.is_error()) {
+    LOG(WARNING) << "block scan #" << scan_id_ << " invalid checkpoint: " << last_seqno.error();
+    return;
+  }
+
+  if (last_seqno.ok() >= next_seqno_) {
+    LOG(INFO) << "block scan #" << scan_id_ << " resuming after checkpoint " << last_seqno.ok();
+    next_seqno_ = last_seqno.ok() + 1;
+    start_at_head_ = false;
+  }
+}
+
+void BlockScanner::flush_checkpoint() {
+  if (!config_.checkpoint_path.has_value() || !checkpoint_dirty_) {
+    return;
+  }
+
+  auto tmp_path = *config_.checkpoint_path;
+  tmp_path += ".tmp";
+
+  auto status = td::write_file(tmp_path.string(), std::to_string(next_undelivered_seqno_ - 1));
+  if (status.is_error()) {
+    LOG(WARNING) << "block scan #" << scan_id_ << " failed to write checkpoint: " << status;
+    return;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, *config_.checkpoint_path, ec);
+  if (ec) {
+    LOG(WARNING) << "block scan #" << scan_id_ << " failed to write checkpoint: " << ec.message();
+    return;
+  }
+
+  checkpoint_dirty_ = false;
+}
+
+void BlockScanner::finish(td::Status status) {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+
+  LOG(INFO) << "block scan #" << scan_id_ << " finished: " << status;
+  flush_checkpoint();
+  callback_->on_finished(std::move(status));
+  td::actor::send_closure(router_, &MultiClientActor::on_block_scan_finished, scan_id_);
+}
+
+}  // namespace multiclient
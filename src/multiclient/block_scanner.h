@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+#include "auto/tl/tonlib_api.h"
+#include "request.h"
+#include "td/actor/ActorId.h"
+#include "td/actor/actor.h"
+#include "td/utils/Status.h"
+#include "td/utils/Time.h"
+
+namespace multiclient {
+
+class MultiClientActor;
+
+struct BlockScanConfig {
+  int32_t from_seqno = 0;
+  int32_t to_seqno = 0;
+  size_t parallelism = 16;
+  bool in_order = true;
+  bool archival = false;
+  std::optional<std::filesystem::path> checkpoint_path = std::nullopt;
+  int32_t transactions_page_size = 256;
+  size_t max_retries = 5;
+  bool with_shards = true;
+  bool with_transactions = true;
+};
+
+struct BlockFollowConfig {
+  // Defaults to the current cluster head.
+  std::optional<int32_t> from_seqno = std::nullopt;
+  size_t parallelism = 4;
+  bool with_shards = false;
+  bool with_transactions = false;
+  std::optional<std::filesystem::path> checkpoint_path = std::nullopt;
+  int32_t transactions_page_size = 256;
+};
+
+struct ScannedShardBlock {
+  ton::tonlib_api::object_ptr<ton::tonlib_api::ton_blockIdExt> block_id;
+  std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::blocks_shortTxId>> transactions;
+};
+
+struct ScannedBlock {
+  int32_t mc_seqno = 0;
+  // The masterchain block goes first, shard blocks follow in `blocks_getShards` order.
+  std::vector<ScannedShardBlock> blocks;
+};
+
+class BlockScanCallback {
+public:
+  virtual void on_block(ScannedBlock block) = 0;
+  virtual void on_finished(td::Status status) = 0;
+  virtual ~BlockScanCallback() = default;
+};
+
+// Walks a masterchain range through `blocks_lookupBlock` -> `blocks_getShards` -> paginated `blocks_getTransactions`
+// for every shard block. Each step is routed through the `MultiClientActor`, so consecutive steps of one block may land
+// on different workers and up to `parallelism` masterchain blocks are processed at once.
+// When constructed from `BlockFollowConfig` the range is open: blocks above the cluster head are parked in the router
+// until some worker reaches them, and every step is sent only to workers that have already seen the block.
+class BlockScanner : public td::actor::Actor {
+public:
+  BlockScanner(
+      uint64_t scan_id,
+      td::actor::ActorId<MultiClientActor> router,
+      BlockScanConfig config,
+      std::unique_ptr<BlockScanCallback> callback
+  );
+  BlockScanner(
+      uint64_t scan_id,
+      td::actor::ActorId<MultiClientActor> router,
+      BlockFollowConfig config,
+      std::unique_ptr<BlockScanCallback> callback
+  );
+
+  void start_up() final;
+  void alarm() final;
+  void tear_down() final;
+
+private:
+  struct BlockState {
+    ScannedBlock result;
+    size_t pending_steps = 0;
+  };
+
+  void schedule_blocks();
+  void wait_for_head();
+  void on_head(td::Result<int32_t> head);
+
+  void lookup_block(int32_t mc_seqno, size_t attempt);
+  void on_block_looked_up(
+      int32_t mc_seqno,
+      size_t attempt,
+      td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::ton_blockIdExt>> result
+  );
+
+  void get_shards(int32_t mc_seqno, ton::tonlib_api::ton_blockIdExt mc_block_id, size_t attempt);
+  void on_shards(
+      int32_t mc_seqno,
+      ton::tonlib_api::ton_blockIdExt mc_block_id,
+      size_t attempt,
+      td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::blocks_shards>> result
+  );
+
+  void get_transactions(
+      int32_t mc_seqno,
+      size_t block_index,
+      ton::tonlib_api::ton_blockIdExt block_id,
+      std::optional<ton::tonlib_api::blocks_accountTransactionId> after,
+      size_t attempt
+  );
+  void on_transactions(
+      int32_t mc_seqno,
+      size_t block_index,
+      ton::tonlib_api::ton_blockIdExt block_id,
+      std::optional<ton::tonlib_api::blocks_accountTransactionId> after,
+      size_t attempt,
+      td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::blocks_transactions>> result
+  );
+
+  RequestParameters step_parameters(int32_t mc_seqno, size_t attempt) const;
+  void retry_step(int32_t mc_seqno, size_t attempt, const td::Status& error, std::function<void()> step);
+
+  void on_step_done(int32_t mc_seqno);
+  void deliver_ready_blocks();
+  void mark_delivered(int32_t mc_seqno);
+
+  void load_checkpoint();
+  void flush_checkpoint();
+  void finish(td::Status status);
+
+  const uint64_t scan_id_;
+  const td::actor::ActorId<MultiClientActor> router_;
+  const BlockScanConfig config_;
+  const bool follow_head_;
+  std::unique_ptr<BlockScanCallback> callback_;
+
+  bool start_at_head_ = false;
+  bool waiting_for_head_ = false;
+  int32_t known_head_ = -1;
+
+  int32_t next_seqno_ = 0;
+  int32_t next_undelivered_seqno_ = 0;
+  std::map<int32_t, BlockState> in_flight_;
+  std::map<int32_t, ScannedBlock> ready_;
+  std::set<int32_t> delivered_ahead_;
+
+  std::multimap<double, std::function<void()>> delayed_steps_;
+
+  td::Timestamp next_checkpoint_flush_ = td::Timestamp::never();
+  bool checkpoint_dirty_ = false;
+  bool finished_ = false;
+};
+
+}  // namespace multiclient
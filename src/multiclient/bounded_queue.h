@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace multiclient {
+
+// Lock-free bounded multi-producer multi-consumer queue (D. Vyukov's array queue). `capacity` is rounded up to a power
+// of two.
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : mask_(round_up(capacity) - 1), cells_(new Cell[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Moves from `value` only on success.
+  bool try_push(T& value) {
+    auto pos = push_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      auto& cell = cells_[pos & mask_];
+      auto sequence = cell.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (push_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = push_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool try_pop(T& value) {
+    auto pos = pop_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      auto& cell = cells_[pos & mask_];
+      auto sequence = cell.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (pop_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          value = std::move(cell.value);
+          cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = pop_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t round_up(size_t capacity) {
+    size_t result = 2;
+    while (result < capacity) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<size_t> push_pos_{0};
+  alignas(64) std::atomic<size_t> pop_pos_{0};
+};
+
+}  // namespace multiclient
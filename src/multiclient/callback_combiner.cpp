@@ -0,0 +1,109 @@
+#include "callback_combiner.h"
+#include <utility>
+#include <vector>
+#include "request.h"
+
+namespace multiclient {
+
+namespace {
+
+static constexpr int64_t kUndefinedClientId = -1;
+
+}  // namespace
+
+CallbackCombiner::CallbackCombiner(std::shared_ptr<ResponseCallback> callback) : callback_(std::move(callback)) {
+}
+
+uint64_t CallbackCombiner::expect(uint64_t id, size_t legs, double now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto token = kReservedRequestIdBit | kCombinedRequestIdBit | next_token_++;
+  entries_.emplace(token, Entry{.id = id, .pending = legs, .created_at = now});
+  return token;
+}
+
+void CallbackCombiner::on_result(
+    int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::Object> result
+) {
+  if ((id & kCombinedRequestIdBit) != 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(id);
+    // A leg of a request that was already answered and forgotten.
+    if (it == entries_.end()) {
+      return;
+    }
+    auto& entry = it->second;
+    bool is_first = !entry.is_delivered;
+    entry.is_delivered = true;
+    id = entry.id;
+    if (--entry.pending == 0) {
+      entries_.erase(it);
+    }
+    if (!is_first) {
+      return;
+    }
+  }
+  callback_->on_result(client_id, id, std::move(result));
+}
+
+void CallbackCombiner::on_error(
+    int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::error> error
+) {
+  if ((id & kCombinedRequestIdBit) != 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(id);
+    if (it == entries_.end()) {
+      return;
+    }
+    auto& entry = it->second;
+    entry.error_code = error->code_;
+    entry.error_message = error->message_;
+    if (--entry.pending > 0) {
+      return;
+    }
+    bool is_delivered = entry.is_delivered;
+    id = entry.id;
+    entries_.erase(it);
+    if (is_delivered) {
+      return;
+    }
+    error->message_ = "all workers failed, last error: " + error->message_;
+    client_id = kUndefinedClientId;
+  }
+  callback_->on_error(client_id, id, std::move(error));
+}
+
+void CallbackCombiner::expire(double now, double timeout) {
+  // Answered entries stay until their last leg reports, so late legs are dropped instead of reaching the callback.
+  // Legs of retired workers never report; their entries are dropped after this many timeouts.
+  static constexpr double kDeliveredEntryTimeouts = 10;
+
+  std::vector<std::pair<uint64_t, Entry>> expired;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      auto& entry = it->second;
+      auto age = now - entry.created_at;
+      if (!entry.is_delivered && age >= timeout) {
+        expired.emplace_back(it->first, entry);
+        entry.is_delivered = true;
+      }
+      if (entry.is_delivered && age >= timeout * kDeliveredEntryTimeouts) {
+        it = entries_.erase(it);
+        continue;
+      }
+      ++it;
+    }
+  }
+
+  for (auto& [_, entry] : expired) {
+    auto message = entry.error_message.empty() ? std::string("request timed out") :
+                                                 "request timed out, last error: " + entry.error_message;
+    callback_->on_error(
+        kUndefinedClientId,
+        entry.id,
+        ton::tonlib_api::make_object<ton::tonlib_api::error>(entry.error_code != 0 ? entry.error_code : 500, message)
+    );
+  }
+}
+
+}  // namespace multiclient
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "auto/tl/tonlib_api.h"
+#include "response_callback.h"
+
+namespace multiclient {
+
+// Sits between the workers and the user callback and turns the responses of one `RequestCallback` sent to several
+// workers into one: the first result, or a single error once every worker has failed. Such a request is sent under a
+// token from `expect`, which is translated back to its id here, so requests reusing an id never share state. Ids that
+// are not tokens pass through unchanged. Called from the worker threads.
+class CallbackCombiner : public ResponseCallback {
+public:
+  explicit CallbackCombiner(std::shared_ptr<ResponseCallback> callback);
+
+  // Returns the token to send the `legs` requests of `id` under.
+  uint64_t expect(uint64_t id, size_t legs, double now);
+
+  void on_result(int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::Object> result) final;
+  void on_error(int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::error> error) final;
+
+  // Fails the requests that got no result within `timeout` seconds, e.g. because their workers were retired. Legs that
+  // answer later are dropped.
+  void expire(double now, double timeout);
+
+private:
+  struct Entry {
+    uint64_t id = 0;
+    size_t pending = 0;
+    bool is_delivered = false;
+    double created_at = 0;
+    int32_t error_code = 0;
+    std::string error_message;
+  };
+
+  const std::shared_ptr<ResponseCallback> callback_;
+  std::mutex mutex_;
+  // By token.
+  std::unordered_map<uint64_t, Entry> entries_;
+  uint64_t next_token_ = 0;
+};
+
+}  // namespace multiclient
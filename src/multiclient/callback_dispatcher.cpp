@@ -0,0 +1,85 @@
+#include "callback_dispatcher.h"
+#include <algorithm>
+#include <span>
+#include <utility>
+#include <vector>
+#include "td/utils/logging.h"
+
+namespace multiclient {
+
+CallbackDispatcher::CallbackDispatcher(std::unique_ptr<ResponseCallback> callback, CallbackDispatchConfig config) :
+    callback_(std::move(callback)), config_(config), queue_(config.queue_size), thread_([this] { run(); }) {
+}
+
+CallbackDispatcher::~CallbackDispatcher() {
+  stop();
+}
+
+void CallbackDispatcher::on_result(
+    int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::Object> result
+) {
+  push(CallbackResponse{.client_id = client_id, .id = id, .result = std::move(result)});
+}
+
+void CallbackDispatcher::on_error(
+    int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::error> error
+) {
+  push(CallbackResponse{.client_id = client_id, .id = id, .error = std::move(error)});
+}
+
+void CallbackDispatcher::push(CallbackResponse response) {
+  while (!is_stopped_.load(std::memory_order_acquire)) {
+    if (queue_.try_push(response)) {
+      pushed_count_.fetch_add(1, std::memory_order_release);
+      pushed_count_.notify_one();
+      return;
+    }
+    if (config_.overflow_policy == CallbackOverflowPolicy::Drop) {
+      break;
+    }
+    std::this_thread::yield();
+  }
+
+  auto dropped = dropped_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if ((dropped & (dropped - 1)) == 0) {
+    LOG(WARNING) << "callback queue is full, " << dropped << " responses dropped";
+  }
+}
+
+void CallbackDispatcher::stop() {
+  if (is_stopped_.exchange(true)) {
+    return;
+  }
+  pushed_count_.fetch_add(1, std::memory_order_release);
+  pushed_count_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void CallbackDispatcher::run() {
+  const auto max_batch_size = std::max<size_t>(config_.max_batch_size, 1);
+  std::vector<CallbackResponse> batch;
+  batch.reserve(max_batch_size);
+
+  while (true) {
+    auto pushed_count = pushed_count_.load(std::memory_order_acquire);
+
+    CallbackResponse response;
+    while (batch.size() < max_batch_size && queue_.try_pop(response)) {
+      batch.push_back(std::move(response));
+    }
+    if (!batch.empty()) {
+      callback_->on_results(std::span<CallbackResponse>(batch));
+      batch.clear();
+      continue;
+    }
+
+    if (is_stopped_.load(std::memory_order_acquire)) {
+      return;
+    }
+    pushed_count_.wait(pushed_count, std::memory_order_acquire);
+  }
+}
+
+}  // namespace multiclient
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "auto/tl/tonlib_api.h"
+#include "bounded_queue.h"
+#include "response_callback.h"
+
+namespace multiclient {
+
+enum class CallbackOverflowPolicy : uint8_t {
+  // The worker waits for room in the queue, which slows down the requests behind it.
+  Block,
+  // The response is dropped and counted.
+  Drop,
+};
+
+struct CallbackDispatchConfig {
+  size_t queue_size = 1 << 16;
+  size_t max_batch_size = 256;
+  CallbackOverflowPolicy overflow_policy = CallbackOverflowPolicy::Block;
+};
+
+// Takes responses from the workers into a lock-free queue and hands them to the user callback in batches through
+// `ResponseCallback::on_results`, on a thread of its own, so a slow callback does not hold up the scheduler threads.
+class CallbackDispatcher : public ResponseCallback {
+public:
+  CallbackDispatcher(std::unique_ptr<ResponseCallback> callback, CallbackDispatchConfig config);
+  ~CallbackDispatcher() override;
+
+  void on_result(int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::Object> result) final;
+  void on_error(int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::error> error) final;
+
+  // Delivers what is already queued and joins the dispatch thread; later responses are dropped.
+  void stop();
+
+  uint64_t dropped_count() const {
+    return dropped_count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  void push(CallbackResponse response);
+  void run();
+
+  const std::unique_ptr<ResponseCallback> callback_;
+  const CallbackDispatchConfig config_;
+  BoundedQueue<CallbackResponse> queue_;
+  // Bumped after every push and on stop; the dispatch thread waits on it while the queue is empty.
+  std::atomic<uint64_t> pushed_count_{0};
+  std::atomic<uint64_t> dropped_count_{0};
+  std::atomic<bool> is_stopped_{false};
+  std::thread thread_;
+};
+
+}  // namespace multiclient
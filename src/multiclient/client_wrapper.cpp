@@ -16,8 +16,17 @@
 
 namespace multiclient {
 
-ClientWrapper::ClientWrapper(uint64_t client_id, ClientConfig config, std::shared_ptr<ResponseCallback> callback) :
-    td::actor::Actor(), client_id_(client_id), config_(std::move(config)), callback_(std::move(callback)) {
+ClientWrapper::ClientWrapper(
+    uint64_t client_id,
+    ClientConfig config,
+    std::shared_ptr<ResponseCallback> callback,
+    std::shared_ptr<LiteServerTransport> transport
+) :
+    td::actor::Actor(),
+    client_id_(client_id),
+    config_(std::move(config)),
+    callback_(std::move(callback)),
+    transport_(std::move(transport)) {
 }
 
 ClientWrapper::ClientWrapper(ClientConfig config, std::shared_ptr<ResponseCallback> callback) :
@@ -92,6 +101,12 @@ void ClientWrapper::on_inited() {
 void ClientWrapper::on_cb_result(uint64_t id, tonlib_api::object_ptr<tonlib_api::Object> result) {
   LOG(DEBUG) << "on_cb_result id: " << id;
 
+  if (id == 0 && result->get_id() == tonlib_api::updateSendLiteServerQuery::ID) {
+    auto query = tonlib_api::move_object_as<tonlib_api::updateSendLiteServerQuery>(std::move(result));
+    on_lite_server_query(query->id_, std::move(query->data_));
+    return;
+  }
+
   if (auto it = tracking_requests_.find(id); it != tracking_requests_.end()) {
     auto promise = std::move(it->second);
     tracking_requests_.erase(it);
@@ -117,8 +132,39 @@ void ClientWrapper::on_cb_error(uint64_t id, tonlib_api::object_ptr<tonlib_api::
   }
 }
 
+void ClientWrapper::on_lite_server_query(int64_t query_id, std::string data) {
+  if (transport_ == nullptr) {
+    on_lite_server_answer(query_id, td::Status::Error("No lite server transport"));
+    return;
+  }
+
+  transport_->send_query(
+      td::BufferSlice(data), [self_id = actor_id(this), query_id](td::Result<td::BufferSlice> answer) {
+        td::actor::send_closure(self_id, &ClientWrapper::on_lite_server_answer, query_id, std::move(answer));
+      }
+  );
+}
+
+void ClientWrapper::on_lite_server_answer(int64_t query_id, td::Result<td::BufferSlice> answer) {
+  static constexpr int32_t kNetworkErrorCode = 500;
+
+  if (answer.is_error()) {
+    send_request_function<tonlib_api::onLiteServerQueryError>(
+        tonlib_api::make_object<tonlib_api::onLiteServerQueryError>(
+            query_id, tonlib_api::make_object<tonlib_api::error>(kNetworkErrorCode, answer.error().message().str())
+        ),
+        [](auto) {}
+    );
+    return;
+  }
+
+  send_request_function<tonlib_api::onLiteServerQueryResult>(
+      tonlib_api::make_object<tonlib_api::onLiteServerQueryResult>(query_id, answer.ok().as_slice().str()), [](auto) {}
+  );
+}
+
 void ClientWrapper::send_request_json(std::string request, td::Promise<std::string> promise) {
-  auto request_id = request_id_++;
+  auto request_id = next_internal_request_id();
   auto object_json_res = td::json_decode(request);
   if (object_json_res.is_error()) {
     promise.set_error(td::Status::Error("Failed to decode json request from string"));
@@ -139,6 +185,166 @@ void ClientWrapper::send_request_json(std::string request, td::Promise<std::stri
   send_callback_request(request_id, std::move(func));
 }
 
+void ClientWrapper::run_get_method(
+    std::string address,
+    int32_t mc_seqno,
+    std::variant<std::string, int32_t> method,
+    std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::tvm_StackEntry>> stack,
+    td::Promise<ton::tonlib_api::object_ptr<ton::tonlib_api::smc_runResult>> promise
+) {
+  PendingGetMethod request{.method = std::move(method), .stack = std::move(stack), .promise = std::move(promise)};
+
+  if (auto it = smc_handles_.find(address); it != smc_handles_.end() && it->second.mc_seqno >= mc_seqno) {
+    smc_handles_lru_.splice(smc_handles_lru_.begin(), smc_handles_lru_, it->second.lru_it);
+    run_smc_method(address, it->second.id, std::move(request));
+    return;
+  }
+
+  // Only a load started for the same or a newer block can serve this call; otherwise its state may be too old.
+  auto& loads = smc_loading_[address];
+  if (auto load = loads.lower_bound(mc_seqno); load != loads.end()) {
+    load->second.push_back(std::move(request));
+    return;
+  }
+  loads[mc_seqno].push_back(std::move(request));
+
+  send_request_function<ton::tonlib_api::smc_load>(
+      ton::tonlib_api::make_object<ton::tonlib_api::smc_load>(
+          ton::tonlib_api::make_object<ton::tonlib_api::accountAddress>(address)
+      ),
+      [self_id = actor_id(this), address, mc_seqno](auto result) mutable {
+        td::actor::send_closure(
+            self_id, &ClientWrapper::on_smc_loaded, std::move(address), mc_seqno, std::move(result)
+        );
+      }
+  );
+}
+
+void ClientWrapper::on_smc_loaded(
+    std::string address, int32_t mc_seqno, td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::smc_info>> result
+) {
+  auto& loads = smc_loading_[address];
+  auto waiters = std::move(loads[mc_seqno]);
+  loads.erase(mc_seqno);
+  if (loads.empty()) {
+    smc_loading_.erase(address);
+  }
+
+  if (result.is_error()) {
+    for (auto& waiter : waiters) {
+      waiter.promise.set_error(result.error().clone());
+    }
+    return;
+  }
+
+  auto smc_id = result.ok()->id_;
+  if (auto it = smc_handles_.find(address); it != smc_handles_.end()) {
+    if (it->second.mc_seqno > mc_seqno) {
+      // A load for a newer block finished first; its handle serves these calls too.
+      forget_smc(smc_id);
+      smc_handles_lru_.splice(smc_handles_lru_.begin(), smc_handles_lru_, it->second.lru_it);
+      for (auto& waiter : waiters) {
+        run_smc_method(address, it->second.id, std::move(waiter));
+      }
+      return;
+    }
+    forget_smc(it->second.id);
+    smc_handles_lru_.erase(it->second.lru_it);
+    smc_handles_.erase(it);
+  }
+
+  smc_handles_lru_.push_front(address);
+  smc_handles_.emplace(address, SmcHandle{.id = smc_id, .mc_seqno = mc_seqno, .lru_it = smc_handles_lru_.begin()});
+
+  while (smc_handles_.size() > config_.smc_cache_size && !smc_handles_lru_.empty()) {
+    auto it = smc_handles_.find(smc_handles_lru_.back());
+    forget_smc(it->second.id);
+    smc_handles_.erase(it);
+    smc_handles_lru_.pop_back();
+  }
+
+  for (auto& waiter : waiters) {
+    run_smc_method(address, smc_id, std::move(waiter));
+  }
+}
+
+void ClientWrapper::run_smc_method(const std::string& address, int64_t smc_id, PendingGetMethod request) {
+  ton::tonlib_api::object_ptr<ton::tonlib_api::smc_MethodId> method_id;
+  if (std::holds_alternative<std::string>(request.method)) {
+    method_id = ton::tonlib_api::make_object<ton::tonlib_api::smc_methodIdName>(std::get<std::string>(request.method));
+  } else {
+    method_id = ton::tonlib_api::make_object<ton::tonlib_api::smc_methodIdNumber>(std::get<int32_t>(request.method));
+  }
+
+  send_request_function<ton::tonlib_api::smc_runGetMethod>(
+      ton::tonlib_api::make_object<ton::tonlib_api::smc_runGetMethod>(
+          smc_id, std::move(method_id), std::move(request.stack)
+      ),
+      [self_id = actor_id(this), address, smc_id, promise = std::move(request.promise)](auto result) mutable {
+        if (result.is_error()) {
+          td::actor::send_closure(self_id, &ClientWrapper::on_smc_run_failed, std::move(address), smc_id);
+        }
+        promise.set_result(std::move(result));
+      }
+  );
+}
+
+void ClientWrapper::on_smc_run_failed(std::string address, int64_t smc_id) {
+  // The handle may be unusable, so the next call loads the account again.
+  auto it = smc_handles_.find(address);
+  if (it != smc_handles_.end() && it->second.id == smc_id) {
+    forget_smc(smc_id);
+    smc_handles_lru_.erase(it->second.lru_it);
+    smc_handles_.erase(it);
+  }
+}
+
+void ClientWrapper::forget_smc(int64_t smc_id) {
+  send_request_function<ton::tonlib_api::smc_forget>(
+      ton::tonlib_api::make_object<ton::tonlib_api::smc_forget>(smc_id), [](auto) {}
+  );
+}
+
+void ClientWrapper::get_memory_usage(td::Promise<WorkerMemoryUsage> promise) {
+  // Estimates, since neither this wrapper's bookkeeping nor tonlib's caches expose their size. The requests and
+  // responses themselves are measured by the router, see `WorkerStats::in_flight_bytes`.
+  // Map entry and promise of one tracked request, without the request.
+  static constexpr size_t kTrackingRequestBytes = 256;
+  static constexpr size_t kSmcHandleBytes = 512;
+  static constexpr size_t kPendingGetMethodBytes = 512;
+  // Tonlib estimate: account state, code and data kept by tonlib for one loaded smc.
+  static constexpr size_t kTonlibSmcStateBytes = 16 << 10;
+  // Tonlib estimate: block and proof caches of an initialized `TonlibClient`.
+  static constexpr size_t kTonlibBaseBytes = 8 << 20;
+
+  size_t pending_get_methods = 0;
+  for (const auto& [_, loads] : smc_loading_) {
+    for (const auto& [_, waiters] : loads) {
+      pending_get_methods += waiters.size();
+    }
+  }
+
+  promise.set_value(WorkerMemoryUsage{
+      .tracking_requests = tracking_requests_.size(),
+      .smc_handles = smc_handles_.size(),
+      .pending_get_methods = pending_get_methods,
+      .tracking_bytes =
+          tracking_requests_.size() * kTrackingRequestBytes + pending_get_methods * kPendingGetMethodBytes,
+      .smc_handles_bytes = smc_handles_.size() * kSmcHandleBytes,
+      .tonlib_bytes = (inited_ ? kTonlibBaseBytes : 0) + smc_handles_.size() * kTonlibSmcStateBytes,
+      .tonlib_base_bytes = inited_ ? kTonlibBaseBytes : 0,
+  });
+}
+
+void ClientWrapper::trim_caches() {
+  LOG(INFO) << "trimming " << smc_handles_.size() << " smc handles of worker #" << client_id_;
+  for (const auto& [_, handle] : smc_handles_) {
+    forget_smc(handle.id);
+  }
+  smc_handles_.clear();
+  smc_handles_lru_.clear();
+}
+
 void ClientWrapper::send_callback_request(
     uint64_t request_id, ton::tonlib_api::object_ptr<ton::tonlib_api::Function>&& request
 ) {
@@ -2,13 +2,19 @@
 
 #include <cstdint>
 #include <filesystem>
+#include <list>
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <variant>
+#include <vector>
 #include "auto/tl/tonlib_api.h"
+#include "lite_server_transport.h"
+#include "request.h"
 #include "response_callback.h"
 #include "td/actor/ActorOwn.h"
 #include "td/actor/PromiseFuture.h"
@@ -24,12 +30,36 @@ struct ClientConfig {
   std::string blockchain_name = "mainnet";
   bool use_callbacks_for_network = false;
   bool ignore_cache = false;
+  size_t smc_cache_size = 1024;
+};
+
+// Estimated memory held by one worker. Counts come from the wrapper's own maps, byte sizes are estimates because
+// `TonlibClient` does not expose its allocations.
+// Estimated from counts, see `ClientWrapper::get_memory_usage`; the `tonlib_*` figures are tonlib estimates.
+struct WorkerMemoryUsage {
+  size_t tracking_requests = 0;
+  size_t smc_handles = 0;
+  size_t pending_get_methods = 0;
+  size_t tracking_bytes = 0;
+  size_t smc_handles_bytes = 0;
+  size_t tonlib_bytes = 0;
+  // Part of `tonlib_bytes` every initialized `TonlibClient` holds whatever its load; trimming cannot release it.
+  size_t tonlib_base_bytes = 0;
+
+  size_t total_bytes() const {
+    return tracking_bytes + smc_handles_bytes + tonlib_bytes;
+  }
 };
 
 class ClientWrapper : public td::actor::Actor {
 public:
   explicit ClientWrapper(ClientConfig config, std::shared_ptr<ResponseCallback> callback);
-  explicit ClientWrapper(uint64_t client_id, ClientConfig config, std::shared_ptr<ResponseCallback> callback);
+  explicit ClientWrapper(
+      uint64_t client_id,
+      ClientConfig config,
+      std::shared_ptr<ResponseCallback> callback,
+      std::shared_ptr<LiteServerTransport> transport = nullptr
+  );
 
   void start_up() override;
   void alarm() override;
@@ -43,22 +73,67 @@ public:
   void send_callback_request(uint64_t request_id, ton::tonlib_api::object_ptr<ton::tonlib_api::Function>&& request);
   void send_request_json(std::string req, td::Promise<std::string> promise);
 
+  // Runs a get-method through a cached `smc_load` handle, reused while it was loaded at `mc_seqno` or later.
+  void run_get_method(
+      std::string address,
+      int32_t mc_seqno,
+      std::variant<std::string, int32_t> method,
+      std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::tvm_StackEntry>> stack,
+      td::Promise<ton::tonlib_api::object_ptr<ton::tonlib_api::smc_runResult>> promise
+  );
+
+  void get_memory_usage(td::Promise<WorkerMemoryUsage> promise);
+  // Releases every cached `smc_load` handle, together with the account states tonlib keeps for them.
+  void trim_caches();
+
 private:
+  struct SmcHandle {
+    int64_t id;
+    int32_t mc_seqno;
+    std::list<std::string>::iterator lru_it;
+  };
+
+  struct PendingGetMethod {
+    std::variant<std::string, int32_t> method;
+    std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::tvm_StackEntry>> stack;
+    td::Promise<ton::tonlib_api::object_ptr<ton::tonlib_api::smc_runResult>> promise;
+  };
+
   void try_init();
   void on_inited();
 
   void on_cb_result(uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::Object> result);
   void on_cb_error(uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::error> error);
 
+  void on_lite_server_query(int64_t query_id, std::string data);
+  void on_lite_server_answer(int64_t query_id, td::Result<td::BufferSlice> answer);
+
+  void on_smc_loaded(
+      std::string address, int32_t mc_seqno, td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::smc_info>> result
+  );
+  void run_smc_method(const std::string& address, int64_t smc_id, PendingGetMethod request);
+  void on_smc_run_failed(std::string address, int64_t smc_id);
+  void forget_smc(int64_t smc_id);
+
+  uint64_t next_internal_request_id() {
+    return kReservedRequestIdBit | request_id_++;
+  }
+
   const uint64_t client_id_;
   const ClientConfig config_;
   std::shared_ptr<ResponseCallback> callback_;
+  std::shared_ptr<LiteServerTransport> transport_;
   td::actor::ActorOwn<tonlib::TonlibClient> tonlib_client_;
 
   std::unordered_map<uint64_t, td::Promise<ton::tonlib_api::object_ptr<ton::tonlib_api::Object>>> tracking_requests_;
 
+  std::unordered_map<std::string, SmcHandle> smc_handles_;
+  std::list<std::string> smc_handles_lru_;
+  // In-flight `smc_load`s per address, by the masterchain seqno they were started for.
+  std::unordered_map<std::string, std::map<int32_t, std::vector<PendingGetMethod>>> smc_loading_;
+
   bool inited_ = false;
-  size_t request_id_ = 100;
+  uint64_t request_id_ = 100;
 };
 
 template <typename T>
@@ -75,7 +150,7 @@ template <typename T>
 void ClientWrapper::send_request_function(
     ton::tonlib_api::object_ptr<T>&& req, td::Promise<typename T::ReturnType> promise
 ) {
-  auto request_id = request_id_++;
+  auto request_id = next_internal_request_id();
   tracking_requests_.emplace(request_id, [p = std::move(promise)](auto res) mutable {
     if (res.is_error()) {
       p.set_error(res.move_as_error());
@@ -0,0 +1,176 @@
+#include "code_cache.h"
+#include <utility>
+#include "td/utils/crypto.h"
+#include "vm/boc.h"
+#include "vm/dict.h"
+
+namespace multiclient {
+
+CodeCache::CodeCache(size_t max_size_bytes) : max_size_bytes_(max_size_bytes) {
+}
+
+td::Result<std::shared_ptr<const CodeCache::Code>> CodeCache::get_code(td::Slice serialized_code) {
+  static constexpr size_t kAliasBytes = 128;
+
+  // The same code may come in differently serialized bags of cells, so entries are keyed by the code cell hash. The
+  // hash of the serialized bytes is only an alias that lets a repeated BOC skip deserialization.
+  td::Bits256 serialized_hash;
+  td::sha256(serialized_code, serialized_hash.as_slice());
+  auto alias = alias_key(serialized_hash);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto* alias_entry = find(alias)) {
+      if (auto* entry = find(alias_entry->alias_of)) {
+        hits_++;
+        return entry->code;
+      }
+    }
+    misses_++;
+  }
+
+  TRY_RESULT(root, vm::std_boc_deserialize(serialized_code));
+  td::Bits256 hash;
+  hash = root->get_hash().bits();
+  auto key = code_key(hash);
+  auto code = std::make_shared<const Code>(Code{.hash = hash, .root = std::move(root)});
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto* entry = find(key)) {
+    // Another thread deserialized it meanwhile, or it came in another serialization; keep the shared entry.
+    code = entry->code;
+  } else {
+    insert(key, Entry{.code = code, .size_bytes = serialized_code.size()});
+  }
+  if (find(alias) == nullptr) {
+    insert(std::move(alias), Entry{.alias_of = std::move(key), .size_bytes = kAliasBytes});
+  }
+  return code;
+}
+
+std::shared_ptr<const CodeCache::Code> CodeCache::add_code_library(
+    const std::shared_ptr<const Code>& code, const td::Bits256& library_hash, td::Ref<vm::Cell> library
+) {
+  // Approximate bytes of a cell beyond its data bits: descriptors, hashes and references.
+  static constexpr size_t kCellOverheadBytes = 48;
+
+  vm::CellStorageStat library_stat;
+  auto library_info = library_stat.compute_used_storage(library);
+  auto library_bytes = library_info.is_ok() ?
+      static_cast<size_t>(library_stat.bits / 8 + library_stat.cells * kCellOverheadBytes) :
+      size_t{0};
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto key = code_key(code->hash);
+  auto* entry = find(key);
+  // The cached entry may already know more libraries than the caller's snapshot.
+  const auto& base = entry != nullptr ? entry->code : code;
+
+  vm::Dictionary libraries{base->libraries, 256};
+  libraries.set_ref(library_hash.bits(), 256, std::move(library));
+
+  auto updated_code = std::make_shared<Code>(*base);
+  updated_code->libraries = libraries.get_root_cell();
+  std::shared_ptr<const Code> result = std::move(updated_code);
+  if (entry != nullptr) {
+    // The entry now keeps the library cells alive too, so they count towards its size.
+    entry->code = result;
+    entry->size_bytes += library_bytes;
+    size_bytes_ += library_bytes;
+    evict(key);
+  }
+  return result;
+}
+
+std::optional<td::Ref<vm::Cell>> CodeCache::get_library(const td::Bits256& library_hash) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto* entry = find(library_key(library_hash))) {
+    hits_++;
+    return entry->library;
+  }
+  misses_++;
+  return std::nullopt;
+}
+
+td::Result<td::Ref<vm::Cell>> CodeCache::add_library(const td::Bits256& library_hash, td::Slice serialized_library) {
+  TRY_RESULT(library, vm::std_boc_deserialize(serialized_library));
+  td::Bits256 actual_hash;
+  actual_hash = library->get_hash().bits();
+  if (actual_hash != library_hash) {
+    return td::Status::Error("Library hash mismatch");
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto key = library_key(library_hash);
+  if (find(key) == nullptr) {
+    insert(std::move(key), Entry{.library = library, .size_bytes = serialized_library.size()});
+  }
+  return library;
+}
+
+CodeCacheStats CodeCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return CodeCacheStats{
+      .code_entries = code_entries_,
+      .library_entries = entries_.size() - code_entries_ - alias_entries_,
+      .size_bytes = size_bytes_,
+      .hits = hits_,
+      .misses = misses_,
+  };
+}
+
+std::string CodeCache::code_key(const td::Bits256& hash) {
+  return "c" + hash.as_slice().str();
+}
+
+std::string CodeCache::library_key(const td::Bits256& hash) {
+  return "l" + hash.as_slice().str();
+}
+
+std::string CodeCache::alias_key(const td::Bits256& hash) {
+  return "a" + hash.as_slice().str();
+}
+
+CodeCache::Entry* CodeCache::find(const std::string& key) {
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+  return &it->second;
+}
+
+void CodeCache::insert(std::string key, Entry entry) {
+  if (entry.size_bytes > max_size_bytes_) {
+    return;
+  }
+
+  lru_.push_front(key);
+  entry.lru_it = lru_.begin();
+  size_bytes_ += entry.size_bytes;
+  if (entry.code != nullptr) {
+    code_entries_++;
+  }
+  if (!entry.alias_of.empty()) {
+    alias_entries_++;
+  }
+  entries_.emplace(key, std::move(entry));
+  evict(key);
+}
+
+void CodeCache::evict(const std::string& keep_key) {
+  while (size_bytes_ > max_size_bytes_ && !lru_.empty() && lru_.back() != keep_key) {
+    auto it = entries_.find(lru_.back());
+    size_bytes_ -= it->second.size_bytes;
+    if (it->second.code != nullptr) {
+      code_entries_--;
+    }
+    if (!it->second.alias_of.empty()) {
+      alias_entries_--;
+    }
+    entries_.erase(it);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace multiclient
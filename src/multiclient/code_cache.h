@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include "td/utils/Slice.h"
+#include "td/utils/Status.h"
+#include "td/utils/bits.h"
+#include "vm/cells.h"
+
+namespace multiclient {
+
+struct CodeCacheStats {
+  size_t code_entries = 0;
+  size_t library_entries = 0;
+  size_t size_bytes = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+// Deserialized contract code and library cells shared by all local get-method runs. Code is keyed by its cell hash, so
+// accounts sharing the same code (wallets, jetton wallets) share one entry however it was serialized, and a repeated
+// serialization is not deserialized again. Entries are evicted in LRU order once the size of everything cached, the
+// library cells attached to code included, exceeds `max_size_bytes`.
+class CodeCache {
+public:
+  struct Code {
+    td::Bits256 hash;
+    td::Ref<vm::Cell> root;
+    // Dictionary of the library cells this code was seen to load, ready for `SmartContract::Args::set_libraries`.
+    td::Ref<vm::Cell> libraries;
+  };
+
+  explicit CodeCache(size_t max_size_bytes);
+
+  td::Result<std::shared_ptr<const Code>> get_code(td::Slice serialized_code);
+  // Returns `code` extended with the library and makes the cached entry, if still present, use it as well.
+  std::shared_ptr<const Code> add_code_library(
+      const std::shared_ptr<const Code>& code, const td::Bits256& library_hash, td::Ref<vm::Cell> library
+  );
+
+  std::optional<td::Ref<vm::Cell>> get_library(const td::Bits256& library_hash);
+  td::Result<td::Ref<vm::Cell>> add_library(const td::Bits256& library_hash, td::Slice serialized_library);
+
+  CodeCacheStats stats() const;
+
+private:
+  struct Entry {
+    std::shared_ptr<const Code> code;
+    td::Ref<vm::Cell> library;
+    // Key of the code entry this serialization hash stands for.
+    std::string alias_of;
+    size_t size_bytes = 0;
+    std::list<std::string>::iterator lru_it;
+  };
+
+  static std::string code_key(const td::Bits256& hash);
+  static std::string library_key(const td::Bits256& hash);
+  static std::string alias_key(const td::Bits256& hash);
+
+  Entry* find(const std::string& key);
+  void insert(std::string key, Entry entry);
+  // Drops least recently used entries, but not `keep_key`, until the cache is back within its size.
+  void evict(const std::string& keep_key);
+
+  const size_t max_size_bytes_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::list<std::string> lru_;
+  size_t code_entries_ = 0;
+  size_t alias_entries_ = 0;
+  size_t size_bytes_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+}  // namespace multiclient
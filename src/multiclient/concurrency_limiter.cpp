@@ -0,0 +1,76 @@
+#include "concurrency_limiter.h"
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include "common/errorcode.h"
+
+namespace multiclient {
+
+SampleOutcome classify_error(const td::Status& error) {
+  // Direct lite server queries fail with the lite server's own codes, tonlib requests with code 500 and a message
+  // naming the lite server error.
+  if (error.code() == ton::ErrorCode::notready || error.code() == ton::ErrorCode::timeout) {
+    return SampleOutcome::Unavailable;
+  }
+  static constexpr std::array<std::string_view, 5> kUnavailableMarkers = {
+      "LITE_SERVER_NETWORK",
+      "LITE_SERVER_TIMEOUT",
+      "LITE_SERVER_NOTREADY",
+      "timeout",
+      "not ready",
+  };
+  auto message = error.message();
+  std::string_view text(message.data(), message.size());
+  for (auto marker : kUnavailableMarkers) {
+    if (text.find(marker) != std::string_view::npos) {
+      return SampleOutcome::Unavailable;
+    }
+  }
+  return SampleOutcome::ApplicationError;
+}
+
+ConcurrencyLimiter::ConcurrencyLimiter(ConcurrencyLimiterConfig config) :
+    config_(config), limit_(std::clamp(config.initial_limit, config.min_limit, config.max_limit)) {
+}
+
+void ConcurrencyLimiter::on_sample(
+    double now, int32_t function_id, double latency, SampleOutcome outcome, size_t in_flight
+) {
+  bool is_overloaded = outcome == SampleOutcome::Unavailable;
+  if (!is_overloaded) {
+    // Application errors can come back without the server doing the work, so only successes set the minimum.
+    auto it = min_latencies_.find(function_id);
+    if (outcome == SampleOutcome::Success) {
+      if (it == min_latencies_.end()) {
+        it = min_latencies_.emplace(function_id, latency).first;
+      } else {
+        it->second = std::min(latency, it->second * (1 + config_.min_latency_drift));
+      }
+    }
+    if (it == min_latencies_.end()) {
+      return;
+    }
+    latency_ratio_ = it->second > 0 ? latency / it->second : 1;
+    is_overloaded = latency_ratio_ > config_.latency_tolerance;
+  }
+
+  if (is_overloaded) {
+    if (now >= next_decrease_at_) {
+      limit_ = std::max(config_.min_limit, limit_ * config_.backoff_ratio);
+      next_decrease_at_ = now + latency;
+    }
+    return;
+  }
+
+  // Do not grow a limit that the traffic does not reach. About `limit_` requests finish per round trip, so each adds
+  // `1 / limit_` and the limit grows by one per round trip.
+  if (outcome == SampleOutcome::Success && static_cast<double>(in_flight) * 2 >= limit_) {
+    limit_ = std::min(config_.max_limit, limit_ + 1 / limit_);
+  }
+}
+
+size_t ConcurrencyLimiter::limit() const {
+  return static_cast<size_t>(limit_);
+}
+
+}  // namespace multiclient
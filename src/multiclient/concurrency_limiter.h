@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include "td/utils/Status.h"
+
+namespace multiclient {
+
+struct ConcurrencyLimiterConfig {
+  double initial_limit = 16;
+  double min_limit = 1;
+  double max_limit = 512;
+  // Multiplicative decrease applied when the lite server is unavailable and when latency grows past
+  // `latency_tolerance` times the no-load latency of the same TL function.
+  double backoff_ratio = 0.9;
+  double latency_tolerance = 2.0;
+  // How fast the no-load latency estimates forget an old minimum, per sample.
+  double min_latency_drift = 0.001;
+};
+
+enum class SampleOutcome : uint8_t {
+  Success,
+  // The lite server answered with an error about the request itself, e.g. a missing account or block or a failed
+  // get-method. Says nothing about its load.
+  ApplicationError,
+  // A network failure, a timeout or a lite server that is not ready.
+  Unavailable,
+};
+
+// Outcome of a request that failed with `error`.
+SampleOutcome classify_error(const td::Status& error);
+
+// AIMD limit on the requests in flight to one lite server. The limit grows by one per round trip while it is actually
+// used, and shrinks multiplicatively when the server is unavailable or when latency rises well above the lowest
+// recently seen for the same TL function, which is taken as queueing inside the server. At most one decrease is
+// applied per observed round trip.
+class ConcurrencyLimiter {
+public:
+  ConcurrencyLimiter() = default;
+  explicit ConcurrencyLimiter(ConcurrencyLimiterConfig config);
+
+  // `in_flight` is the number of requests that were running when this one finished, including it.
+  void on_sample(double now, int32_t function_id, double latency, SampleOutcome outcome, size_t in_flight);
+
+  size_t limit() const;
+  // Latency of the last sample divided by the no-load latency of its TL function.
+  double latency_ratio() const {
+    return latency_ratio_;
+  }
+
+private:
+  ConcurrencyLimiterConfig config_;
+  double limit_ = config_.initial_limit;
+  // No-load latency by TL function id, since one get-method can take a hundred times as long as a masterchain info.
+  std::unordered_map<int32_t, double> min_latencies_;
+  double latency_ratio_ = 0;
+  double next_decrease_at_ = 0;
+};
+
+}  // namespace multiclient
@@ -0,0 +1,69 @@
+#include "get_method_batch.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include "multi_client_actor.h"
+
+namespace multiclient {
+
+GetMethodBatch::GetMethodBatch(
+    uint64_t batch_id,
+    td::actor::ActorId<MultiClientActor> router,
+    RequestGetMethodBatch batch,
+    td::Promise<GetMethodBatchResults> promise
+) :
+    batch_id_(batch_id), router_(std::move(router)), batch_(std::move(batch)), promise_(std::move(promise)) {
+}
+
+void GetMethodBatch::start_up() {
+  // With no request allowed in flight nothing would ever be sent and the batch would never finish.
+  batch_.parallelism = std::max<size_t>(batch_.parallelism, 1);
+  results_.resize(batch_.requests.size());
+  order_.resize(batch_.requests.size());
+  std::iota(order_.begin(), order_.end(), 0);
+  std::stable_sort(order_.begin(), order_.end(), [&](size_t lhs, size_t rhs) {
+    return batch_.requests[lhs].address < batch_.requests[rhs].address;
+  });
+
+  LOG(DEBUG) << "get-method batch #" << batch_id_ << ": " << order_.size() << " requests";
+
+  if (order_.empty()) {
+    promise_.set_value(std::move(results_));
+    td::actor::send_closure(router_, &MultiClientActor::on_get_method_batch_finished, batch_id_);
+    return;
+  }
+  dispatch();
+}
+
+void GetMethodBatch::dispatch() {
+  while (next_ < order_.size() && in_flight_ < batch_.parallelism) {
+    auto index = order_[next_++];
+    in_flight_++;
+
+    auto promise = td::Promise<RunResultPtr>([self_id = actor_id(this), index](td::Result<RunResultPtr> result) {
+      td::actor::send_closure(self_id, &GetMethodBatch::on_result, index, std::move(result));
+    });
+
+    td::actor::send_closure(
+        router_,
+        batch_.run_locally ? &MultiClientActor::run_get_method_locally : &MultiClientActor::run_get_method,
+        std::move(batch_.requests[index]),
+        std::move(promise)
+    );
+  }
+}
+
+void GetMethodBatch::on_result(size_t index, td::Result<RunResultPtr> result) {
+  results_[index] = std::move(result);
+  in_flight_--;
+  completed_++;
+
+  if (completed_ == order_.size()) {
+    promise_.set_value(std::move(results_));
+    td::actor::send_closure(router_, &MultiClientActor::on_get_method_batch_finished, batch_id_);
+    return;
+  }
+  dispatch();
+}
+
+}  // namespace multiclient
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "local_get_method.h"
+#include "request.h"
+#include "td/actor/ActorId.h"
+#include "td/actor/PromiseFuture.h"
+#include "td/actor/actor.h"
+#include "td/utils/Status.h"
+
+namespace multiclient {
+
+class MultiClientActor;
+
+struct RequestGetMethodBatch {
+  std::vector<RequestGetMethod> requests;
+  // Values below 1 are treated as 1.
+  size_t parallelism = 64;
+  // Run on the linked TVM (`run_get_method_locally`) instead of through `smc_runGetMethod` on the workers.
+  bool run_locally = false;
+};
+
+using GetMethodBatchResults = std::vector<td::Result<RunResultPtr>>;
+
+// Runs every request of a batch with at most `parallelism` in flight. Requests for the same address are dispatched next
+// to each other so they share one state load (an `smc_load` handle or a local account state), and results are
+// returned in input order with a separate status per item.
+class GetMethodBatch : public td::actor::Actor {
+public:
+  GetMethodBatch(
+      uint64_t batch_id,
+      td::actor::ActorId<MultiClientActor> router,
+      RequestGetMethodBatch batch,
+      td::Promise<GetMethodBatchResults> promise
+  );
+
+  void start_up() final;
+
+private:
+  void dispatch();
+  void on_result(size_t index, td::Result<RunResultPtr> result);
+
+  const uint64_t batch_id_;
+  const td::actor::ActorId<MultiClientActor> router_;
+  RequestGetMethodBatch batch_;
+  td::Promise<GetMethodBatchResults> promise_;
+
+  std::vector<size_t> order_;
+  GetMethodBatchResults results_;
+  size_t next_ = 0;
+  size_t in_flight_ = 0;
+  size_t completed_ = 0;
+};
+
+}  // namespace multiclient
@@ -0,0 +1,88 @@
+#include "global_config.h"
+#include <utility>
+#include "td/utils/JsonBuilder.h"
+
+namespace multiclient {
+
+namespace {
+
+std::string to_json(const td::JsonValue& value) {
+  td::JsonBuilder builder;
+  builder.enter_value() << value;
+  return builder.string_builder().as_cslice().str();
+}
+
+std::string to_json(const LiteServerConfig& lite_server) {
+  std::string id;
+  {
+    td::JsonBuilder builder;
+    auto obj = builder.enter_object();
+    obj("@type", "pub.ed25519");
+    obj("key", lite_server.key);
+    obj.leave();
+    id = builder.string_builder().as_cslice().str();
+  }
+
+  td::JsonBuilder builder;
+  auto obj = builder.enter_object();
+  obj("ip", lite_server.ip);
+  obj("port", lite_server.port);
+  obj("id", td::JsonRaw(id));
+  obj.leave();
+  return builder.string_builder().as_cslice().str();
+}
+
+}  // namespace
+
+td::Result<std::vector<std::string>> split_global_config(
+    std::string global_config, const std::vector<LiteServerConfig>& lite_servers
+) {
+  TRY_RESULT(config_json, td::json_decode(global_config));
+  if (config_json.type() != td::JsonValue::Type::Object) {
+    return td::Status::Error("Global config must be an object");
+  }
+  auto& config_object = config_json.get_object();
+
+  TRY_RESULT(dht, get_json_object_field(config_object, "dht", td::JsonValue::Type::Object, false));
+  TRY_RESULT(type, get_json_object_field(config_object, "@type", td::JsonValue::Type::String, false));
+  TRY_RESULT(validator, get_json_object_field(config_object, "validator", td::JsonValue::Type::Object, false));
+  auto dht_json = to_json(dht);
+  auto type_json = to_json(type);
+  auto validator_json = to_json(validator);
+
+  std::vector<std::string> lite_server_jsons;
+  if (lite_servers.empty()) {
+    TRY_RESULT(
+        liteservers, get_json_object_field(config_object, "liteservers", td::JsonValue::Type::Array, false)
+    );
+    lite_server_jsons.reserve(liteservers.get_array().size());
+    for (const auto& ls_json : liteservers.get_array()) {
+      lite_server_jsons.push_back(to_json(ls_json));
+    }
+  } else {
+    lite_server_jsons.reserve(lite_servers.size());
+    for (const auto& lite_server : lite_servers) {
+      lite_server_jsons.push_back(to_json(lite_server));
+    }
+  }
+  if (lite_server_jsons.empty()) {
+    return td::Status::Error("Global config has no lite servers");
+  }
+
+  std::vector<std::string> result;
+  result.reserve(lite_server_jsons.size());
+  for (const auto& ls_json : lite_server_jsons) {
+    td::JsonBuilder builder;
+    auto obj = builder.enter_object();
+    obj("dht", td::JsonRaw(dht_json));
+    obj("@type", td::JsonRaw(type_json));
+    obj("validator", td::JsonRaw(validator_json));
+    obj("liteservers", td::JsonRaw("[" + ls_json + "]"));
+    obj.leave();
+    result.push_back(builder.string_builder().as_cslice().str());
+  }
+
+  return result;
+}
+
+}  // namespace multiclient
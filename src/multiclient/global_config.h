@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "td/utils/Status.h"
+
+namespace multiclient {
+
+struct LiteServerConfig {
+  // IPv4 address in the signed integer form used by global configs.
+  int32_t ip = 0;
+  int32_t port = 0;
+  // Base64 encoded ed25519 public key.
+  std::string key;
+};
+
+// Splits a global config into one config per lite server, each keeping the shared `dht` and `validator` sections.
+// The config is decoded once and the shared sections are serialized once. When `lite_servers` is not empty it replaces
+// the `liteservers` list of the config.
+td::Result<std::vector<std::string>> split_global_config(
+    std::string global_config, const std::vector<LiteServerConfig>& lite_servers = {}
+);
+
+}  // namespace multiclient
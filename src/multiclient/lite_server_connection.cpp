@@ -0,0 +1,106 @@
+#include "lite_server_connection.h"
+#include <memory>
+#include <utility>
+#include "td/utils/JsonBuilder.h"
+#include "td/utils/base64.h"
+#include "td/utils/logging.h"
+
+namespace multiclient {
+
+td::Result<LiteServerDescription> parse_lite_server(td::Slice global_config) {
+  auto config_str = global_config.str();
+  TRY_RESULT(config_json, td::json_decode(config_str));
+  if (config_json.type() != td::JsonValue::Type::Object) {
+    return td::Status::Error("Global config must be an object");
+  }
+
+  TRY_RESULT(
+      liteservers, get_json_object_field(config_json.get_object(), "liteservers", td::JsonValue::Type::Array, false)
+  );
+  auto& ls_array = liteservers.get_array();
+  if (ls_array.empty() || ls_array[0].type() != td::JsonValue::Type::Object) {
+    return td::Status::Error("Global config has no lite servers");
+  }
+  auto& ls_object = ls_array[0].get_object();
+
+  TRY_RESULT(ip, get_json_object_int_field(ls_object, "ip", false));
+  TRY_RESULT(port, get_json_object_int_field(ls_object, "port", false));
+  TRY_RESULT(id, get_json_object_field(ls_object, "id", td::JsonValue::Type::Object, false));
+  TRY_RESULT(key_base64, get_json_object_string_field(id.get_object(), "key", false));
+  TRY_RESULT(key, td::base64_decode(key_base64));
+  if (key.size() != 32) {
+    return td::Status::Error("Invalid lite server key");
+  }
+
+  td::Bits256 key_bits;
+  key_bits.as_slice().copy_from(key);
+
+  LiteServerDescription result;
+  TRY_STATUS(result.address.init_ipv4_port(td::IPAddress::ipv4_to_str(ip), port));
+  result.key = ton::PublicKey(ton::pubkeys::Ed25519(key_bits));
+  return result;
+}
+
+LiteServerConnection::LiteServerConnection(size_t worker_index, LiteServerDescription lite_server) :
+    worker_index_(worker_index), lite_server_(std::move(lite_server)) {
+}
+
+void LiteServerConnection::start_up() {
+  class Callback : public ton::adnl::AdnlExtClient::Callback {
+  public:
+    explicit Callback(td::actor::ActorId<LiteServerConnection> connection_id) : connection_id_(connection_id) {
+    }
+
+    void on_ready() final {
+      td::actor::send_closure(connection_id_, &LiteServerConnection::on_ready);
+    }
+
+    void on_stop_ready() final {
+      td::actor::send_closure(connection_id_, &LiteServerConnection::on_stop_ready);
+    }
+
+  private:
+    td::actor::ActorId<LiteServerConnection> connection_id_;
+  };
+
+  client_ = ton::adnl::AdnlExtClient::create(
+      ton::adnl::AdnlNodeIdFull(lite_server_.key), lite_server_.address, std::make_unique<Callback>(actor_id(this))
+  );
+}
+
+void LiteServerConnection::send_raw_query(td::BufferSlice query, td::Promise<td::BufferSlice> promise) {
+  send_adnl_query(
+      ton::create_serialize_tl_object<ton::lite_api::liteServer_query>(std::move(query)), std::move(promise)
+  );
+}
+
+void LiteServerConnection::send_adnl_query(td::BufferSlice query, td::Promise<td::BufferSlice> promise) {
+  static constexpr double kQueryTimeout = 10.0;
+
+  if (!is_ready_) {
+    promise.set_error(td::Status::Error("Lite server connection is not ready"));
+    return;
+  }
+
+  // Every query of this lite server is multiplexed over the one connection; each is sent as its own ADNL message.
+  td::actor::send_closure(
+      client_,
+      &ton::adnl::AdnlExtClient::send_query,
+      "query",
+      std::move(query),
+      td::Timestamp::in(kQueryTimeout),
+      std::move(promise)
+  );
+}
+
+void LiteServerConnection::on_ready() {
+  LOG(DEBUG) << "LS #" << worker_index_ << " direct connection is ready";
+  is_ready_ = true;
+}
+
+void LiteServerConnection::on_stop_ready() {
+  LOG(DEBUG) << "LS #" << worker_index_ << " direct connection is lost";
+  is_ready_ = false;
+}
+
+}  // namespace multiclient
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "adnl/adnl-ext-client.h"
+#include "auto/tl/lite_api.h"
+#include "keys/keys.hpp"
+#include "lite_server_transport.h"
+#include "td/actor/ActorId.h"
+#include "td/actor/ActorOwn.h"
+#include "td/actor/PromiseFuture.h"
+#include "td/actor/actor.h"
+#include "td/utils/Status.h"
+#include "td/utils/Time.h"
+#include "td/utils/buffer.h"
+#include "td/utils/port/IPAddress.h"
+#include "tl-utils/common-utils.hpp"
+#include "tl-utils/lite-utils.hpp"
+
+namespace multiclient {
+
+struct LiteServerDescription {
+  td::IPAddress address;
+  ton::PublicKey key;
+};
+
+// Reads the first entry of `liteservers` from a global config.
+td::Result<LiteServerDescription> parse_lite_server(td::Slice global_config);
+
+// Speaks `lite_api` to one lite server over its own ADNL connection, without going through `TonlibClient`. Results are
+// returned as received and are not checked against proofs.
+class LiteServerConnection : public td::actor::Actor {
+public:
+  LiteServerConnection(size_t worker_index, LiteServerDescription lite_server);
+
+  void start_up() final;
+
+  template <typename T>
+  void send_query(T query, td::Promise<typename T::ReturnType> promise);
+
+  void send_raw_query(td::BufferSlice query, td::Promise<td::BufferSlice> promise);
+  // Sends an already wrapped `liteServer.query`.
+  void send_adnl_query(td::BufferSlice query, td::Promise<td::BufferSlice> promise);
+
+private:
+  void on_ready();
+  void on_stop_ready();
+
+  const size_t worker_index_;
+  const LiteServerDescription lite_server_;
+  td::actor::ActorOwn<ton::adnl::AdnlExtClient> client_;
+  bool is_ready_ = false;
+};
+
+// Shares one connection between the direct queries and the `TonlibClient` of the same worker.
+class LiteServerConnectionTransport : public LiteServerTransport {
+public:
+  explicit LiteServerConnectionTransport(td::actor::ActorId<LiteServerConnection> connection) :
+      connection_(std::move(connection)) {
+  }
+
+  void send_query(td::BufferSlice query, td::Promise<td::BufferSlice> promise) final {
+    td::actor::send_closure(connection_, &LiteServerConnection::send_adnl_query, std::move(query), std::move(promise));
+  }
+
+private:
+  td::actor::ActorId<LiteServerConnection> connection_;
+};
+
+template <typename T>
+void LiteServerConnection::send_query(T query, td::Promise<typename T::ReturnType> promise) {
+  send_raw_query(
+      ton::serialize_tl_object(&query, true),
+      promise.wrap([](td::BufferSlice data) -> td::Result<typename T::ReturnType> {
+        auto error = ton::fetch_tl_object<ton::lite_api::liteServer_error>(data.clone(), true);
+        if (error.is_ok()) {
+          return td::Status::Error(error.ok()->code_, error.ok()->message_);
+        }
+        return ton::fetch_result<T>(std::move(data));
+      })
+  );
+}
+
+}  // namespace multiclient
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include "td/actor/PromiseFuture.h"
+#include "td/utils/buffer.h"
+
+namespace multiclient {
+
+// Carries the lite server traffic of a `TonlibClient` running with `use_callbacks_for_network`. Implementations are
+// called from the worker actor and may answer from any actor.
+class LiteServerTransport {
+public:
+  virtual ~LiteServerTransport() = default;
+
+  // `query` is a serialized `liteServer.query`, the answer is the raw lite server response.
+  virtual void send_query(td::BufferSlice query, td::Promise<td::BufferSlice> promise) = 0;
+};
+
+// Returns the transport for the worker of lite server `worker_index`; called every time that worker is started.
+using LiteServerTransportFactory = std::function<std::shared_ptr<LiteServerTransport>(size_t worker_index)>;
+
+}  // namespace multiclient
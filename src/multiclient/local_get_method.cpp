@@ -0,0 +1,628 @@
+#include "local_get_method.h"
+#include <algorithm>
+#include <utility>
+#include "common/refint.h"
+#include "multi_client_actor.h"
+#include "pinned_accounts.h"
+#include "smc-envelope/SmartContract.h"
+#include "vm/boc.h"
+#include "vm/cellslice.h"
+#include "vm/dict.h"
+#include "vm/stack.hpp"
+
+namespace multiclient {
+
+namespace {
+
+static constexpr int kMaxStackDepth = 64;
+
+td::Result<vm::StackEntry> to_vm_stack_entry(const tonlib_api::tvm_StackEntry& entry, int depth);
+
+td::Result<std::vector<vm::StackEntry>> to_vm_stack_entries(
+    const std::vector<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>>& entries, int depth
+) {
+  std::vector<vm::StackEntry> result;
+  result.reserve(entries.size());
+  for (const auto& entry : entries) {
+    if (entry == nullptr) {
+      return td::Status::Error("Empty stack entry");
+    }
+    TRY_RESULT(vm_entry, to_vm_stack_entry(*entry, depth + 1));
+    result.push_back(std::move(vm_entry));
+  }
+  return result;
+}
+
+td::Result<vm::StackEntry> to_vm_stack_entry(const tonlib_api::tvm_StackEntry& entry, int depth) {
+  if (depth > kMaxStackDepth) {
+    return td::Status::Error("Stack is too deep");
+  }
+
+  switch (entry.get_id()) {
+    case tonlib_api::tvm_stackEntrySlice::ID: {
+      const auto& slice = static_cast<const tonlib_api::tvm_stackEntrySlice&>(entry);
+      TRY_RESULT(cell, vm::std_boc_deserialize(slice.slice_->bytes_));
+      return vm::StackEntry(vm::load_cell_slice_ref(std::move(cell)));
+    }
+    case tonlib_api::tvm_stackEntryCell::ID: {
+      const auto& cell_entry = static_cast<const tonlib_api::tvm_stackEntryCell&>(entry);
+      TRY_RESULT(cell, vm::std_boc_deserialize(cell_entry.cell_->bytes_));
+      return vm::StackEntry(std::move(cell));
+    }
+    case tonlib_api::tvm_stackEntryNumber::ID: {
+      const auto& number = static_cast<const tonlib_api::tvm_stackEntryNumber&>(entry);
+      auto value = td::dec_string_to_int256(number.number_->number_);
+      if (value.is_null()) {
+        return td::Status::Error("Invalid stack number: " + number.number_->number_);
+      }
+      return vm::StackEntry(std::move(value));
+    }
+    case tonlib_api::tvm_stackEntryTuple::ID: {
+      const auto& tuple = static_cast<const tonlib_api::tvm_stackEntryTuple&>(entry);
+      TRY_RESULT(elements, to_vm_stack_entries(tuple.tuple_->elements_, depth));
+      return vm::StackEntry(std::move(elements));
+    }
+    case tonlib_api::tvm_stackEntryList::ID: {
+      const auto& list = static_cast<const tonlib_api::tvm_stackEntryList&>(entry);
+      TRY_RESULT(elements, to_vm_stack_entries(list.list_->elements_, depth));
+      vm::StackEntry tail;
+      for (auto it = elements.rbegin(); it != elements.rend(); ++it) {
+        tail = vm::StackEntry(std::vector<vm::StackEntry>{std::move(*it), std::move(tail)});
+      }
+      return tail;
+    }
+    default:
+      return td::Status::Error("Unsupported stack entry");
+  }
+}
+
+td::Result<std::string> serialize_cell(td::Ref<vm::Cell> cell) {
+  TRY_RESULT(boc, vm::std_boc_serialize(std::move(cell)));
+  return boc.as_slice().str();
+}
+
+bool is_list(const vm::StackEntry& entry) {
+  const auto* current = &entry;
+  while (current->type() == vm::StackEntry::Type::t_tuple) {
+    const auto& tuple = *current->as_tuple();
+    if (tuple.size() != 2) {
+      return false;
+    }
+    current = &tuple[1];
+  }
+  return current->type() == vm::StackEntry::Type::t_null;
+}
+
+td::Result<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>> to_tonlib_stack_entry(
+    const vm::StackEntry& entry, int depth
+) {
+  if (depth > kMaxStackDepth) {
+    return td::Status::Error("Stack is too deep");
+  }
+
+  switch (entry.type()) {
+    case vm::StackEntry::Type::t_int:
+      return tonlib_api::make_object<tonlib_api::tvm_stackEntryNumber>(
+          tonlib_api::make_object<tonlib_api::tvm_numberDecimal>(td::dec_string(entry.as_int()))
+      );
+    case vm::StackEntry::Type::t_cell: {
+      TRY_RESULT(bytes, serialize_cell(entry.as_cell()));
+      return tonlib_api::make_object<tonlib_api::tvm_stackEntryCell>(
+          tonlib_api::make_object<tonlib_api::tvm_cell>(std::move(bytes))
+      );
+    }
+    case vm::StackEntry::Type::t_slice: {
+      vm::CellBuilder builder;
+      builder.append_cellslice(entry.as_slice());
+      TRY_RESULT(bytes, serialize_cell(builder.finalize()));
+      return tonlib_api::make_object<tonlib_api::tvm_stackEntrySlice>(
+          tonlib_api::make_object<tonlib_api::tvm_slice>(std::move(bytes))
+      );
+    }
+    case vm::StackEntry::Type::t_null:
+    case vm::StackEntry::Type::t_tuple: {
+      std::vector<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>> elements;
+      if (is_list(entry)) {
+        for (const auto* current = &entry; current->type() == vm::StackEntry::Type::t_tuple;
+             current = &(*current->as_tuple())[1]) {
+          TRY_RESULT(element, to_tonlib_stack_entry((*current->as_tuple())[0], depth + 1));
+          elements.push_back(std::move(element));
+        }
+        return tonlib_api::make_object<tonlib_api::tvm_stackEntryList>(
+            tonlib_api::make_object<tonlib_api::tvm_list>(std::move(elements))
+        );
+      }
+
+      for (const auto& item : *entry.as_tuple()) {
+        TRY_RESULT(element, to_tonlib_stack_entry(item, depth + 1));
+        elements.push_back(std::move(element));
+      }
+      return tonlib_api::make_object<tonlib_api::tvm_stackEntryTuple>(
+          tonlib_api::make_object<tonlib_api::tvm_tuple>(std::move(elements))
+      );
+    }
+    default:
+      return tonlib_api::make_object<tonlib_api::tvm_stackEntryUnsupported>();
+  }
+}
+
+}  // namespace
+
+td::Result<std::shared_ptr<const LocalAccountState>> make_local_account_state(
+    const std::string& address, const tonlib_api::raw_fullAccountState& account_state, CodeCache* code_cache
+) {
+  if (account_state.code_.empty()) {
+    return td::Status::Error("Account is not active");
+  }
+
+  TRY_RESULT(std_address, block::StdAddress::parse(address));
+
+  std::shared_ptr<const CodeCache::Code> code;
+  if (code_cache != nullptr) {
+    TRY_RESULT_ASSIGN(code, code_cache->get_code(account_state.code_));
+  } else {
+    TRY_RESULT(code_root, vm::std_boc_deserialize(account_state.code_));
+    code = std::make_shared<const CodeCache::Code>(CodeCache::Code{.root = std::move(code_root)});
+  }
+  TRY_RESULT(data, vm::std_boc_deserialize(account_state.data_, true));
+
+  return std::make_shared<const LocalAccountState>(LocalAccountState{
+      .address = std::move(std_address),
+      .mc_seqno = account_state.block_id_ != nullptr ? account_state.block_id_->seqno_ : -1,
+      .code = std::move(code),
+      .data = std::move(data),
+      .balance = account_state.balance_,
+      .sync_utime = account_state.sync_utime_,
+  });
+}
+
+td::Result<LocalRunResult> run_get_method_locally(
+    const LocalAccountState& account,
+    const std::shared_ptr<const block::Config>& config,
+    const std::variant<std::string, int32_t>& method,
+    std::vector<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>> stack
+) {
+  TRY_RESULT(vm_stack, to_vm_stack_entries(stack, 0));
+
+  ton::SmartContract::Args args;
+  if (std::holds_alternative<std::string>(method)) {
+    args.set_method_id(std::get<std::string>(method));
+  } else {
+    args.set_method_id(std::get<int32_t>(method));
+  }
+  args.set_stack(std::move(vm_stack));
+  args.set_balance(account.balance);
+  args.set_now(static_cast<int>(account.sync_utime));
+  args.set_address(account.address);
+  if (config != nullptr) {
+    auto args_config = config;
+    args.set_config(args_config);
+  }
+  if (account.code->libraries.not_null()) {
+    args.set_libraries(vm::Dictionary(account.code->libraries, 256));
+  }
+
+  ton::SmartContract smc(ton::SmartContract::State{account.code->root, account.data});
+  auto answer = smc.run_get_method(std::move(args));
+  if (answer.missing_library.not_null()) {
+    td::Bits256 missing_library;
+    missing_library = answer.missing_library;
+    return LocalRunResult{.missing_library = missing_library};
+  }
+
+  std::vector<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>> result_stack;
+  if (answer.stack.not_null()) {
+    for (const auto& entry : answer.stack->as_span()) {
+      TRY_RESULT(result_entry, to_tonlib_stack_entry(entry, 0));
+      result_stack.push_back(std::move(result_entry));
+    }
+  }
+
+  return LocalRunResult{
+      .result =
+          tonlib_api::make_object<tonlib_api::smc_runResult>(answer.gas_used, std::move(result_stack), answer.code),
+  };
+}
+
+void LocalGetMethodExecutor::run(
+    std::shared_ptr<const LocalAccountState> account,
+    std::shared_ptr<const block::Config> config,
+    std::variant<std::string, int32_t> method,
+    std::vector<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>> stack,
+    td::Promise<LocalRunResult> promise
+) {
+  promise.set_result(run_get_method_locally(*account, config, method, std::move(stack)));
+}
+
+LocalGetMethodRunner::LocalGetMethodRunner(
+    td::actor::ActorId<MultiClientActor> router,
+    std::shared_ptr<PinnedAccountStore> pinned_accounts,
+    std::shared_ptr<CodeCache> code_cache,
+    size_t executor_count
+) :
+    router_(std::move(router)),
+    pinned_accounts_(std::move(pinned_accounts)),
+    code_cache_(std::move(code_cache)),
+    executor_count_(std::max<size_t>(executor_count, 1)) {
+}
+
+void LocalGetMethodRunner::start_up() {
+  executors_.reserve(executor_count_);
+  for (size_t i = 0; i < executor_count_; i++) {
+    executors_.push_back(td::actor::create_actor<LocalGetMethodExecutor>(
+        td::actor::ActorOptions().with_name("multiclient_local_get_method_" + std::to_string(i))
+    ));
+  }
+  wait_for_head();
+}
+
+void LocalGetMethodRunner::run(RequestGetMethod request, td::Promise<RunResultPtr> promise) {
+  if (block::StdAddress::parse(request.address).is_error()) {
+    promise.set_error(td::Status::Error("Invalid account address: " + request.address));
+    return;
+  }
+
+  auto address = request.address;
+  auto& entry = accounts_[address];
+  entry.pending_runs.push_back(PendingRun{.request = std::move(request), .promise = std::move(promise)});
+  process_account(address);
+}
+
+void LocalGetMethodRunner::wait_for_head() {
+  if (waiting_for_head_) {
+    return;
+  }
+  waiting_for_head_ = true;
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::wait_for_mc_seqno,
+      known_head_ + 1,
+      td::Promise<int32_t>([self_id = actor_id(this)](td::Result<int32_t> head) {
+        td::actor::send_closure(self_id, &LocalGetMethodRunner::on_head, std::move(head));
+      })
+  );
+}
+
+void LocalGetMethodRunner::on_head(td::Result<int32_t> head) {
+  waiting_for_head_ = false;
+  if (head.is_error()) {
+    LOG(WARNING) << "local get-method runner failed to wait for the cluster head: " << head.error();
+    return;
+  }
+
+  known_head_ = std::max(known_head_, head.ok());
+  std::erase_if(accounts_, [&](const auto& item) {
+    const auto& entry = item.second;
+    return !entry.is_loading && entry.pending_runs.empty() && entry.loaded_at_head < known_head_;
+  });
+  wait_for_head();
+}
+
+void LocalGetMethodRunner::process_account(const std::string& address) {
+  auto& entry = accounts_[address];
+  if (entry.pending_runs.empty()) {
+    return;
+  }
+
+  // A config from the previous block is good enough to keep running while the fresh one is being fetched.
+  if (config_ == nullptr || config_loaded_at_head_ < known_head_) {
+    load_config();
+  }
+  if (config_ == nullptr) {
+    return;
+  }
+
+  if (entry.state == nullptr || entry.loaded_at_head < known_head_) {
+    if (!entry.is_loading) {
+      load_account(address, entry.pending_runs.front().request.parameters);
+    }
+    return;
+  }
+
+  flush_pending_runs(entry);
+}
+
+void LocalGetMethodRunner::load_account(const std::string& address, const RequestParameters& parameters) {
+  auto& entry = accounts_[address];
+  entry.is_loading = true;
+
+  if (pinned_accounts_ != nullptr) {
+    auto pinned = pinned_accounts_->get(address);
+    if (pinned.is_ok() && pinned.ok().mc_seqno >= known_head_) {
+      set_account_state(address, known_head_, *pinned.ok().state);
+      return;
+    }
+  }
+
+  auto request_parameters = parameters;
+  if (!request_parameters.min_mc_seqno.has_value() && known_head_ >= 0) {
+    request_parameters.min_mc_seqno = known_head_;
+  }
+
+  auto promise = td::Promise<tonlib_api::raw_getAccountState::ReturnType>(
+      [self_id = actor_id(this), address, head = known_head_](auto result) mutable {
+        td::actor::send_closure(
+            self_id, &LocalGetMethodRunner::on_account_loaded, std::move(address), head, std::move(result)
+        );
+      }
+  );
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::send_request_function<tonlib_api::raw_getAccountState>,
+      RequestFunction<tonlib_api::raw_getAccountState>{
+          .parameters = std::move(request_parameters),
+          .request_creator =
+              [address]() {
+                return tonlib_api::make_object<tonlib_api::raw_getAccountState>(
+                    tonlib_api::make_object<tonlib_api::accountAddress>(address)
+                );
+              },
+      },
+      std::move(promise)
+  );
+}
+
+void LocalGetMethodRunner::on_account_loaded(
+    std::string address, int32_t head, td::Result<tonlib_api::object_ptr<tonlib_api::raw_fullAccountState>> result
+) {
+  if (result.is_error()) {
+    auto& entry = accounts_[address];
+    entry.is_loading = false;
+    fail_pending_runs(entry, result.error());
+    return;
+  }
+
+  set_account_state(address, head, *result.ok());
+}
+
+void LocalGetMethodRunner::set_account_state(
+    const std::string& address, int32_t head, const tonlib_api::raw_fullAccountState& account_state
+) {
+  auto& entry = accounts_[address];
+  entry.is_loading = false;
+
+  auto state = make_local_account_state(address, account_state, code_cache_.get());
+  if (state.is_error()) {
+    fail_pending_runs(entry, state.error());
+    return;
+  }
+
+  entry.state = state.move_as_ok();
+  entry.loaded_at_head = head;
+
+  // Runs queued while the state was loading are served from it even if the head has moved on meanwhile.
+  if (config_ != nullptr) {
+    flush_pending_runs(entry);
+  }
+}
+
+void LocalGetMethodRunner::load_config() {
+  static constexpr int32_t kConfigAllMode = 0;
+
+  if (is_config_loading_) {
+    return;
+  }
+  is_config_loading_ = true;
+
+  auto promise = td::Promise<tonlib_api::getConfigAll::ReturnType>(
+      [self_id = actor_id(this), head = known_head_](auto result) {
+        td::actor::send_closure(self_id, &LocalGetMethodRunner::on_config_loaded, head, std::move(result));
+      }
+  );
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::send_request_function<tonlib_api::getConfigAll>,
+      RequestFunction<tonlib_api::getConfigAll>{
+          .parameters =
+              {
+                  .mode = RequestMode::Single,
+                  .min_mc_seqno = known_head_ >= 0 ? std::make_optional(known_head_) : std::nullopt,
+              },
+          .request_creator = []() { return tonlib_api::make_object<tonlib_api::getConfigAll>(kConfigAllMode); },
+      },
+      std::move(promise)
+  );
+}
+
+void LocalGetMethodRunner::on_config_loaded(
+    int32_t head, td::Result<tonlib_api::object_ptr<tonlib_api::configInfo>> result
+) {
+  is_config_loading_ = false;
+
+  auto config = [&]() -> td::Result<std::shared_ptr<const block::Config>> {
+    TRY_RESULT(config_info, std::move(result));
+    TRY_RESULT(config_root, vm::std_boc_deserialize(config_info->config_->bytes_));
+    TRY_RESULT(unpacked_config, block::Config::unpack_config(std::move(config_root)));
+    return std::shared_ptr<const block::Config>(std::move(unpacked_config));
+  }();
+
+  if (config.is_error()) {
+    LOG(WARNING) << "local get-method runner failed to load config: " << config.error();
+    if (config_ == nullptr) {
+      for (auto& [_, entry] : accounts_) {
+        fail_pending_runs(entry, config.error());
+      }
+    }
+    return;
+  }
+
+  config_ = config.move_as_ok();
+  config_loaded_at_head_ = head;
+
+  std::vector<std::string> waiting_addresses;
+  for (const auto& [address, entry] : accounts_) {
+    if (!entry.pending_runs.empty()) {
+      waiting_addresses.push_back(address);
+    }
+  }
+  for (const auto& address : waiting_addresses) {
+    process_account(address);
+  }
+}
+
+void LocalGetMethodRunner::flush_pending_runs(AccountEntry& entry) {
+  auto runs = std::move(entry.pending_runs);
+  entry.pending_runs.clear();
+  for (auto& run : runs) {
+    execute(entry.state, std::move(run));
+  }
+}
+
+void LocalGetMethodRunner::fail_pending_runs(AccountEntry& entry, const td::Status& error) {
+  auto runs = std::move(entry.pending_runs);
+  entry.pending_runs.clear();
+  for (auto& run : runs) {
+    run.promise.set_error(error.clone());
+  }
+}
+
+void LocalGetMethodRunner::execute(
+    std::shared_ptr<const LocalAccountState> state, PendingRun run, size_t library_loads
+) {
+  auto stack = run.request.stack_creator != nullptr ?
+      run.request.stack_creator() :
+      std::vector<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>>{};
+  auto method = run.request.method;
+
+  auto promise = td::Promise<LocalRunResult>(
+      [self_id = actor_id(this), state, run = std::move(run), library_loads](auto result) mutable {
+        td::actor::send_closure(
+            self_id,
+            &LocalGetMethodRunner::on_executed,
+            std::move(state),
+            std::move(run),
+            library_loads,
+            std::move(result)
+        );
+      }
+  );
+
+  auto& executor = executors_[next_executor_++ % executors_.size()];
+  td::actor::send_closure(
+      executor,
+      &LocalGetMethodExecutor::run,
+      std::move(state),
+      config_,
+      std::move(method),
+      std::move(stack),
+      std::move(promise)
+  );
+}
+
+void LocalGetMethodRunner::on_executed(
+    std::shared_ptr<const LocalAccountState> state,
+    PendingRun run,
+    size_t library_loads,
+    td::Result<LocalRunResult> result
+) {
+  static constexpr size_t kMaxLibraryLoads = 8;
+
+  if (result.is_error()) {
+    run.promise.set_error(result.move_as_error());
+    return;
+  }
+
+  auto run_result = result.move_as_ok();
+  if (!run_result.missing_library.has_value()) {
+    run.promise.set_value(std::move(run_result.result));
+    return;
+  }
+
+  if (library_loads >= kMaxLibraryLoads) {
+    run.promise.set_error(td::Status::Error("Too many library cells are loaded by the get-method"));
+    return;
+  }
+
+  auto library_hash = *run_result.missing_library;
+  auto library = code_cache_->get_library(library_hash);
+  if (library.has_value()) {
+    rerun_with_library(std::move(state), library_hash, std::move(*library), std::move(run), library_loads + 1);
+    return;
+  }
+  load_library(library_hash, std::move(state), std::move(run), library_loads + 1);
+}
+
+void LocalGetMethodRunner::load_library(
+    const td::Bits256& library_hash,
+    std::shared_ptr<const LocalAccountState> state,
+    PendingRun run,
+    size_t library_loads
+) {
+  auto& waiters = library_waiters_[library_hash.as_slice().str()];
+  waiters.push_back(LibraryWaiter{.state = std::move(state), .run = std::move(run), .library_loads = library_loads});
+  if (waiters.size() > 1) {
+    return;
+  }
+
+  auto promise = td::Promise<tonlib_api::smc_getLibraries::ReturnType>(
+      [self_id = actor_id(this), library_hash](auto result) {
+        td::actor::send_closure(self_id, &LocalGetMethodRunner::on_library_loaded, library_hash, std::move(result));
+      }
+  );
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::send_request_function<tonlib_api::smc_getLibraries>,
+      RequestFunction<tonlib_api::smc_getLibraries>{
+          .parameters = {.mode = RequestMode::Single},
+          .request_creator =
+              [library_hash]() {
+                return tonlib_api::make_object<tonlib_api::smc_getLibraries>(std::vector<td::Bits256>{library_hash});
+              },
+      },
+      std::move(promise)
+  );
+}
+
+void LocalGetMethodRunner::on_library_loaded(
+    td::Bits256 library_hash, td::Result<tonlib_api::object_ptr<tonlib_api::smc_libraryResult>> result
+) {
+  auto it = library_waiters_.find(library_hash.as_slice().str());
+  if (it == library_waiters_.end()) {
+    return;
+  }
+  auto waiters = std::move(it->second);
+  library_waiters_.erase(it);
+
+  auto library = [&]() -> td::Result<td::Ref<vm::Cell>> {
+    TRY_RESULT(library_result, std::move(result));
+    for (const auto& entry : library_result->result_) {
+      if (entry->hash_ == library_hash) {
+        return code_cache_->add_library(library_hash, entry->data_);
+      }
+    }
+    return td::Status::Error("Library cell is not found: " + library_hash.to_hex());
+  }();
+
+  for (auto& waiter : waiters) {
+    if (library.is_error()) {
+      waiter.run.promise.set_error(library.error().clone());
+      continue;
+    }
+    rerun_with_library(
+        std::move(waiter.state), library_hash, library.ok(), std::move(waiter.run), waiter.library_loads
+    );
+  }
+}
+
+void LocalGetMethodRunner::rerun_with_library(
+    std::shared_ptr<const LocalAccountState> state,
+    const td::Bits256& library_hash,
+    td::Ref<vm::Cell> library,
+    PendingRun run,
+    size_t library_loads
+) {
+  auto updated_state = std::make_shared<LocalAccountState>(*state);
+  updated_state->code = code_cache_->add_code_library(state->code, library_hash, std::move(library));
+
+  auto it = accounts_.find(run.request.address);
+  if (it != accounts_.end() && it->second.state == state) {
+    it->second.state = updated_state;
+  }
+  execute(std::move(updated_state), std::move(run), library_loads);
+}
+
+}  // namespace multiclient
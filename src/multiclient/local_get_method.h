@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+#include "auto/tl/tonlib_api.h"
+#include "block/block.h"
+#include "block/mc-config.h"
+#include "code_cache.h"
+#include "request.h"
+#include "td/actor/ActorId.h"
+#include "td/actor/ActorOwn.h"
+#include "td/actor/PromiseFuture.h"
+#include "td/actor/actor.h"
+#include "td/utils/Status.h"
+#include "vm/cells.h"
+
+namespace multiclient {
+
+class MultiClientActor;
+class PinnedAccountStore;
+
+using RunResultPtr = ton::tonlib_api::object_ptr<ton::tonlib_api::smc_runResult>;
+
+// Everything the TVM needs to run a get-method of one account at one masterchain block.
+struct LocalAccountState {
+  block::StdAddress address;
+  int32_t mc_seqno = -1;
+  std::shared_ptr<const CodeCache::Code> code;
+  td::Ref<vm::Cell> data;
+  int64_t balance = 0;
+  int64_t sync_utime = 0;
+};
+
+struct LocalRunResult {
+  RunResultPtr result;
+  // Set when the code loaded a library cell missing from `LocalAccountState::code`; `result` is meaningless then.
+  std::optional<td::Bits256> missing_library;
+};
+
+// Without a `code_cache` the code is deserialized on every call.
+td::Result<std::shared_ptr<const LocalAccountState>> make_local_account_state(
+    const std::string& address,
+    const ton::tonlib_api::raw_fullAccountState& account_state,
+    CodeCache* code_cache = nullptr
+);
+
+// Runs a get-method on the TVM in the calling thread and returns the result in the `smc_runGetMethod` shape.
+td::Result<LocalRunResult> run_get_method_locally(
+    const LocalAccountState& account,
+    const std::shared_ptr<const block::Config>& config,
+    const std::variant<std::string, int32_t>& method,
+    std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::tvm_StackEntry>> stack
+);
+
+class LocalGetMethodExecutor : public td::actor::Actor {
+public:
+  void run(
+      std::shared_ptr<const LocalAccountState> account,
+      std::shared_ptr<const block::Config> config,
+      std::variant<std::string, int32_t> method,
+      std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::tvm_StackEntry>> stack,
+      td::Promise<LocalRunResult> promise
+  );
+};
+
+// Keeps account states and the blockchain config fetched at most once per masterchain block and spreads the TVM runs
+// over a pool of executor actors, so get-methods scale with the scheduler threads instead of lite server capacity.
+class LocalGetMethodRunner : public td::actor::Actor {
+public:
+  LocalGetMethodRunner(
+      td::actor::ActorId<MultiClientActor> router,
+      std::shared_ptr<PinnedAccountStore> pinned_accounts,
+      std::shared_ptr<CodeCache> code_cache,
+      size_t executor_count
+  );
+
+  void start_up() final;
+
+  void run(RequestGetMethod request, td::Promise<RunResultPtr> promise);
+
+private:
+  struct PendingRun {
+    RequestGetMethod request;
+    td::Promise<RunResultPtr> promise;
+  };
+
+  struct AccountEntry {
+    std::shared_ptr<const LocalAccountState> state;
+    int32_t loaded_at_head = -1;
+    bool is_loading = false;
+    std::vector<PendingRun> pending_runs;
+  };
+
+  void wait_for_head();
+  void on_head(td::Result<int32_t> head);
+
+  void process_account(const std::string& address);
+  void load_account(const std::string& address, const RequestParameters& parameters);
+  void on_account_loaded(
+      std::string address,
+      int32_t head,
+      td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::raw_fullAccountState>> result
+  );
+  void set_account_state(
+      const std::string& address, int32_t head, const ton::tonlib_api::raw_fullAccountState& account_state
+  );
+
+  void load_config();
+  void on_config_loaded(int32_t head, td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::configInfo>> result);
+
+  void flush_pending_runs(AccountEntry& entry);
+  void fail_pending_runs(AccountEntry& entry, const td::Status& error);
+  void execute(std::shared_ptr<const LocalAccountState> state, PendingRun run, size_t library_loads = 0);
+  void on_executed(
+      std::shared_ptr<const LocalAccountState> state,
+      PendingRun run,
+      size_t library_loads,
+      td::Result<LocalRunResult> result
+  );
+
+  void load_library(
+      const td::Bits256& library_hash,
+      std::shared_ptr<const LocalAccountState> state,
+      PendingRun run,
+      size_t library_loads
+  );
+  void on_library_loaded(
+      td::Bits256 library_hash, td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::smc_libraryResult>> result
+  );
+  void rerun_with_library(
+      std::shared_ptr<const LocalAccountState> state,
+      const td::Bits256& library_hash,
+      td::Ref<vm::Cell> library,
+      PendingRun run,
+      size_t library_loads
+  );
+
+  const td::actor::ActorId<MultiClientActor> router_;
+  std::shared_ptr<PinnedAccountStore> pinned_accounts_;
+  std::shared_ptr<CodeCache> code_cache_;
+  const size_t executor_count_;
+
+  std::vector<td::actor::ActorOwn<LocalGetMethodExecutor>> executors_;
+  size_t next_executor_ = 0;
+
+  std::unordered_map<std::string, AccountEntry> accounts_;
+
+  struct LibraryWaiter {
+    std::shared_ptr<const LocalAccountState> state;
+    PendingRun run;
+    size_t library_loads = 0;
+  };
+  std::unordered_map<std::string, std::vector<LibraryWaiter>> library_waiters_;
+
+  std::shared_ptr<const block::Config> config_;
+  int32_t config_loaded_at_head_ = -1;
+  bool is_config_loading_ = false;
+
+  int32_t known_head_ = -1;
+  bool waiting_for_head_ = false;
+};
+
+}  // namespace multiclient
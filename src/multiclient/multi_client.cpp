@@ -10,19 +10,51 @@ namespace multiclient {
 
 MultiClient::MultiClient(MultiClientConfig config, std::unique_ptr<ResponseCallback> callback) :
     config_(std::move(config)),
+    pinned_accounts_(std::make_shared<PinnedAccountStore>()),
     scheduler_(
         std::make_shared<td::actor::Scheduler>(std::vector<td::actor::Scheduler::NodeInfo>{config.scheduler_threads})
     ) {
-  scheduler_->run_in_context_external([this, cb = std::move(callback)]() mutable {
+  auto pin_status = pinned_accounts_->pin(config_.pinned_accounts);
+  if (pin_status.is_error()) {
+    LOG(ERROR) << "failed to pin accounts: " << pin_status;
+  }
+
+  std::shared_ptr<ResponseCallback> response_callback;
+  if (callback != nullptr && config_.callback_dispatch.has_value()) {
+    callback_dispatcher_ = std::make_shared<CallbackDispatcher>(std::move(callback), *config_.callback_dispatch);
+    response_callback = callback_dispatcher_;
+  } else {
+    response_callback = std::move(callback);
+  }
+
+  scheduler_->run_in_context_external([this, cb = std::move(response_callback)]() mutable {
     client_ = td::actor::create_actor<MultiClientActor>(
         "multiclient",
         MultiClientActorConfig{
             .global_config_path = config_.global_config_path,
+            .global_config = config_.global_config,
+            .lite_servers = config_.lite_servers,
             .key_store_root = config_.key_store_root,
             .blockchain_name = config_.blockchain_name,
             .reset_key_store = config_.reset_key_store,
+            .key_store_mode = config_.key_store_mode,
+            .local_get_method_executors = config_.scheduler_threads,
+            .local_code_cache_max_bytes = config_.local_code_cache_max_bytes,
+            .smc_cache_size = config_.smc_cache_size,
+            .direct_lite_server_queries = config_.direct_lite_server_queries,
+            .use_callbacks_for_network = config_.use_callbacks_for_network,
+            .lite_server_transport_factory = config_.lite_server_transport_factory,
+            .combine_callback_responses = config_.combine_callback_responses,
+            .elastic_min_workers = config_.elastic_min_workers,
+            .elastic_scale_up_in_flight = config_.elastic_scale_up_in_flight,
+            .elastic_scale_up_latency = config_.elastic_scale_up_latency,
+            .elastic_retire_idle_after = config_.elastic_retire_idle_after,
+            .worker_memory_cap_bytes = config_.worker_memory_cap_bytes,
+            .total_memory_cap_bytes = config_.total_memory_cap_bytes,
+            .adaptive_concurrency = config_.adaptive_concurrency,
         },
-        std::move(cb)
+        std::move(cb),
+        pinned_accounts_
     );
   });
   scheduler_thread_ = std::thread([scheduler = scheduler_] { scheduler->run(); });
@@ -30,6 +62,9 @@ MultiClient::MultiClient(MultiClientConfig config, std::unique_ptr<ResponseCallb
 
 MultiClient::~MultiClient() {
   scheduler_->stop();
+  if (callback_dispatcher_ != nullptr) {
+    callback_dispatcher_->stop();
+  }
 }
 
 td::Result<std::string> MultiClient::send_request_json(RequestJson req) const {
@@ -53,4 +88,210 @@ void MultiClient::send_callback_request(RequestCallback req) const {
   });
 }
 
+td::Result<uint64_t> MultiClient::start_block_scan(
+    BlockScanConfig config, std::unique_ptr<BlockScanCallback> callback
+) const {
+  std::promise<td::Result<uint64_t>> scan_promise;
+  auto scan_future = scan_promise.get_future();
+
+  auto promise = td::Promise<uint64_t>([p = std::move(scan_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external(
+      [this, p = std::move(promise), config = std::move(config), cb = std::move(callback)]() mutable {
+        td::actor::send_closure(
+            client_.get(), &MultiClientActor::start_block_scan, std::move(config), std::move(cb), std::move(p)
+        );
+      }
+  );
+
+  return scan_future.get();
+}
+
+void MultiClient::stop_block_scan(uint64_t scan_id) const {
+  scheduler_->run_in_context_external([this, scan_id]() {
+    td::actor::send_closure(client_.get(), &MultiClientActor::stop_block_scan, scan_id);
+  });
+}
+
+td::Result<uint64_t> MultiClient::follow_blocks(
+    BlockFollowConfig config, std::unique_ptr<BlockScanCallback> callback
+) const {
+  std::promise<td::Result<uint64_t>> follow_promise;
+  auto follow_future = follow_promise.get_future();
+
+  auto promise = td::Promise<uint64_t>([p = std::move(follow_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external(
+      [this, p = std::move(promise), config = std::move(config), cb = std::move(callback)]() mutable {
+        td::actor::send_closure(
+            client_.get(), &MultiClientActor::follow_blocks, std::move(config), std::move(cb), std::move(p)
+        );
+      }
+  );
+
+  return follow_future.get();
+}
+
+void MultiClient::stop_block_follow(uint64_t follow_id) const {
+  stop_block_scan(follow_id);
+}
+
+td::Result<uint64_t> MultiClient::watch_accounts(
+    AccountWatchConfig config, std::unique_ptr<AccountWatchCallback> callback
+) const {
+  std::promise<td::Result<uint64_t>> watch_promise;
+  auto watch_future = watch_promise.get_future();
+
+  auto promise = td::Promise<uint64_t>([p = std::move(watch_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external(
+      [this, p = std::move(promise), config = std::move(config), cb = std::move(callback)]() mutable {
+        td::actor::send_closure(
+            client_.get(), &MultiClientActor::watch_accounts, std::move(config), std::move(cb), std::move(p)
+        );
+      }
+  );
+
+  return watch_future.get();
+}
+
+td::Status MultiClient::add_watched_accounts(uint64_t watch_id, std::vector<std::string> addresses) const {
+  return update_watched_accounts(watch_id, std::move(addresses), {});
+}
+
+td::Status MultiClient::remove_watched_accounts(uint64_t watch_id, std::vector<std::string> addresses) const {
+  return update_watched_accounts(watch_id, {}, std::move(addresses));
+}
+
+void MultiClient::stop_account_watch(uint64_t watch_id) const {
+  stop_block_scan(watch_id);
+}
+
+td::Status MultiClient::update_watched_accounts(
+    uint64_t watch_id, std::vector<std::string> added, std::vector<std::string> removed
+) const {
+  std::promise<td::Result<td::Unit>> update_promise;
+  auto update_future = update_promise.get_future();
+
+  auto promise = td::Promise<td::Unit>([p = std::move(update_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external(
+      [this, watch_id, p = std::move(promise), added = std::move(added), removed = std::move(removed)]() mutable {
+        td::actor::send_closure(
+            client_.get(),
+            &MultiClientActor::update_watched_accounts,
+            watch_id,
+            std::move(added),
+            std::move(removed),
+            std::move(p)
+        );
+      }
+  );
+
+  auto result = update_future.get();
+  return result.is_error() ? result.move_as_error() : td::Status::OK();
+}
+
+td::Result<std::vector<WorkerStats>> MultiClient::get_worker_stats() const {
+  std::promise<td::Result<std::vector<WorkerStats>>> stats_promise;
+  auto stats_future = stats_promise.get_future();
+
+  auto promise = td::Promise<std::vector<WorkerStats>>([p = std::move(stats_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::get_worker_stats, std::move(p));
+  });
+
+  return stats_future.get();
+}
+
+td::Result<int32_t> MultiClient::wait_for_seqno(int32_t mc_seqno, std::optional<double> timeout) const {
+  std::promise<td::Result<int32_t>> seqno_promise;
+  auto seqno_future = seqno_promise.get_future();
+
+  auto promise = td::Promise<int32_t>([p = std::move(seqno_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, mc_seqno, timeout, p = std::move(promise)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::wait_for_seqno, mc_seqno, timeout, std::move(p));
+  });
+
+  return seqno_future.get();
+}
+
+td::Status MultiClient::pin_accounts(std::vector<std::string> addresses) const {
+  TRY_STATUS(pinned_accounts_->pin(addresses));
+
+  scheduler_->run_in_context_external([this]() {
+    td::actor::send_closure(client_.get(), &MultiClientActor::refresh_pinned_accounts);
+  });
+  return td::Status::OK();
+}
+
+void MultiClient::unpin_accounts(std::vector<std::string> addresses) const {
+  pinned_accounts_->unpin(addresses);
+}
+
+td::Result<PinnedAccountState> MultiClient::get_pinned_account_state(
+    const std::string& address, std::optional<std::chrono::steady_clock::duration> max_age
+) const {
+  return pinned_accounts_->get(address, max_age);
+}
+
+td::Result<RunResultPtr> MultiClient::run_get_method(RequestGetMethod req) const {
+  std::promise<td::Result<RunResultPtr>> run_promise;
+  auto run_future = run_promise.get_future();
+
+  auto promise = td::Promise<RunResultPtr>([p = std::move(run_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), req = std::move(req)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::run_get_method, std::move(req), std::move(p));
+  });
+
+  return run_future.get();
+}
+
+td::Result<RunResultPtr> MultiClient::run_get_method_locally(RequestGetMethod req) const {
+  std::promise<td::Result<RunResultPtr>> run_promise;
+  auto run_future = run_promise.get_future();
+
+  auto promise = td::Promise<RunResultPtr>([p = std::move(run_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), req = std::move(req)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::run_get_method_locally, std::move(req), std::move(p));
+  });
+
+  return run_future.get();
+}
+
+td::Result<GetMethodBatchResults> MultiClient::run_get_methods(RequestGetMethodBatch batch) const {
+  std::promise<td::Result<GetMethodBatchResults>> batch_promise;
+  auto batch_future = batch_promise.get_future();
+
+  auto promise = td::Promise<GetMethodBatchResults>([p = std::move(batch_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), batch = std::move(batch)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::run_get_methods, std::move(batch), std::move(p));
+  });
+
+  return batch_future.get();
+}
+
 }  // namespace multiclient
@@ -1,13 +1,24 @@
 #pragma once
 
+#include <chrono>
 #include <filesystem>
 #include <future>
 #include <memory>
 #include <optional>
 #include <thread>
+#include <vector>
+#include "account_watcher.h"
 #include "auto/tl/tonlib_api.h"
+#include "block_scanner.h"
+#include "callback_dispatcher.h"
+#include "get_method_batch.h"
+#include "global_config.h"
+#include "local_get_method.h"
 #include "multi_client_actor.h"
+#include "pinned_accounts.h"
+#include "promise.h"
 #include "request.h"
+#include "request_chain.h"
 #include "response_callback.h"
 #include "td/actor/ActorId.h"
 #include "td/actor/ActorOwn.h"
@@ -19,10 +30,52 @@ namespace multiclient {
 
 struct MultiClientConfig {
   std::filesystem::path global_config_path;
+  // Global config JSON to use instead of reading `global_config_path`.
+  std::optional<std::string> global_config = std::nullopt;
+  // When not empty, replaces the `liteservers` list of the global config; `dht` and `validator` still come from it.
+  std::vector<LiteServerConfig> lite_servers = {};
   std::optional<std::filesystem::path> key_store_root;
   std::string blockchain_name = "mainnet";
   bool reset_key_store = false;
+  KeyStoreMode key_store_mode = KeyStoreMode::PerWorker;
   size_t scheduler_threads = 1;
+  std::vector<std::string> pinned_accounts;
+  size_t local_code_cache_max_bytes = 64 << 20;
+  // `smc_load` handles each worker keeps for `run_get_method`, least recently used first to go.
+  size_t smc_cache_size = 1024;
+  // Opens a second, tonlib-free connection to every lite server for `send_lite_request`.
+  bool direct_lite_server_queries = false;
+  // Routes the lite server traffic of every `TonlibClient` through the multiclient-owned connection of its worker.
+  bool use_callbacks_for_network = false;
+  // With `use_callbacks_for_network`, carries the traffic over these transports instead of the owned connections,
+  // e.g. to plug in a local stand-in server.
+  LiteServerTransportFactory lite_server_transport_factory = nullptr;
+
+  // Elastic pool: start only `elastic_min_workers` workers and add more when the running ones average more than
+  // `elastic_scale_up_in_flight` requests in flight or `elastic_scale_up_latency` seconds per request. Extra workers
+  // are retired after `elastic_retire_idle_after` seconds without requests.
+  std::optional<size_t> elastic_min_workers = std::nullopt;
+  size_t elastic_scale_up_in_flight = 16;
+  double elastic_scale_up_latency = 2.0;
+  double elastic_retire_idle_after = 300.0;
+
+  // Memory caps on the estimates reported in `WorkerStats`, not counting the fixed base of every client
+  // (`WorkerMemoryUsage::tonlib_base_bytes`). A worker above `worker_memory_cap_bytes` gets no new requests until it is
+  // back under 80% of the cap and drops its cached smc handles; above `total_memory_cap_bytes` new requests are
+  // rejected.
+  std::optional<size_t> worker_memory_cap_bytes = std::nullopt;
+  std::optional<size_t> total_memory_cap_bytes = std::nullopt;
+
+  // Adaptive (AIMD) in-flight limit per worker, adjusted from observed latency and errors. Requests go to workers
+  // below their limit first; the current limits are reported in `WorkerStats::concurrency_limit`.
+  std::optional<ConcurrencyLimiterConfig> adaptive_concurrency = std::nullopt;
+
+  // Deliver `RequestCallback` responses in batches through `ResponseCallback::on_results` on a dedicated thread
+  // instead of calling the callback from the workers.
+  std::optional<CallbackDispatchConfig> callback_dispatch = std::nullopt;
+  // A `RequestCallback` sent to several workers yields one response per request id: the first result, or one error
+  // after every worker failed. Turn off to get every worker's response.
+  bool combine_callback_responses = true;
 };
 
 class MultiClient {
@@ -30,22 +83,136 @@ public:
   explicit MultiClient(MultiClientConfig config, std::unique_ptr<ResponseCallback> callback = nullptr);
   ~MultiClient();
 
+  // Sends any tonlib function through the fastest path that works for it; prefer it over `send_request` and
+  // `send_request_function`.
+  template <typename T>
+  td::Result<typename T::ReturnType> send(Request<T> req) const;
+
+  // Sends the request to every selected worker (see `RequestMode::Gather`) and returns each worker's result, once all
+  // have answered or `parameters.timeout` has passed.
+  template <typename T>
+  td::Result<std::vector<GatherResult<typename T::ReturnType>>> gather(Request<T> req) const;
+
+  // Returns the first `k` successful results, e.g. two independent answers to cross-check, and fails as soon as `k`
+  // successes are no longer possible.
+  template <typename T>
+  td::Result<std::vector<typename T::ReturnType>> first_k(Request<T> req, size_t k) const;
+
   template <typename T>
   td::Result<typename T::ReturnType> send_request(Request<T> req) const;
 
   template <typename T>
   td::Result<typename T::ReturnType> send_request_function(RequestFunction<T> req) const;
 
+  template <typename T>
+  td::Result<typename T::ReturnType> send_lite_request(RequestLite<T> req) const;
+
   td::Result<std::string> send_request_json(RequestJson req) const;
   void send_callback_request(RequestCallback req) const;
 
+  // Runs a chain of dependent requests inside the router; only the final result comes back to the calling thread.
+  template <typename R>
+  td::Result<R> send_request_chain(RequestChain<R> chain) const;
+
+  td::Result<uint64_t> start_block_scan(BlockScanConfig config, std::unique_ptr<BlockScanCallback> callback) const;
+  void stop_block_scan(uint64_t scan_id) const;
+
+  td::Result<uint64_t> follow_blocks(BlockFollowConfig config, std::unique_ptr<BlockScanCallback> callback) const;
+  void stop_block_follow(uint64_t follow_id) const;
+
+  td::Result<uint64_t> watch_accounts(AccountWatchConfig config, std::unique_ptr<AccountWatchCallback> callback) const;
+  td::Status add_watched_accounts(uint64_t watch_id, std::vector<std::string> addresses) const;
+  td::Status remove_watched_accounts(uint64_t watch_id, std::vector<std::string> addresses) const;
+  void stop_account_watch(uint64_t watch_id) const;
+
+  td::Result<std::vector<WorkerStats>> get_worker_stats() const;
+
+  // Blocks until some worker reports masterchain seqno >= `mc_seqno` and returns the cluster head at that moment, or
+  // fails once `timeout` seconds have passed.
+  td::Result<int32_t> wait_for_seqno(int32_t mc_seqno, std::optional<double> timeout = std::nullopt) const;
+
+  td::Status pin_accounts(std::vector<std::string> addresses) const;
+  void unpin_accounts(std::vector<std::string> addresses) const;
+  td::Result<PinnedAccountState> get_pinned_account_state(
+      const std::string& address, std::optional<std::chrono::steady_clock::duration> max_age = std::nullopt
+  ) const;
+
+  // Loads the account with `smc_load` on one worker and reuses that handle for later calls within the same block.
+  td::Result<RunResultPtr> run_get_method(RequestGetMethod req) const;
+
+  // Runs the get-method on the linked TVM against the account state and config of the latest known masterchain block.
+  td::Result<RunResultPtr> run_get_method_locally(RequestGetMethod req) const;
+
+  // Results are in the order of `batch.requests`; a failed item does not fail the batch.
+  td::Result<GetMethodBatchResults> run_get_methods(RequestGetMethodBatch batch) const;
+
 private:
+  td::Status update_watched_accounts(
+      uint64_t watch_id, std::vector<std::string> added, std::vector<std::string> removed
+  ) const;
+
   const MultiClientConfig config_;
+  std::shared_ptr<PinnedAccountStore> pinned_accounts_;
   std::shared_ptr<td::actor::Scheduler> scheduler_;
+  std::shared_ptr<CallbackDispatcher> callback_dispatcher_;
   std::thread scheduler_thread_;
   td::actor::ActorOwn<MultiClientActor> client_;
 };
 
+template <typename T>
+td::Result<typename T::ReturnType> MultiClient::send(Request<T> req) const {
+  using ReturnType = typename T::ReturnType;
+
+  std::promise<td::Result<ReturnType>> request_promise;
+  auto request_future = request_promise.get_future();
+
+  auto promise = td::Promise<ReturnType>([p = std::move(request_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), req = std::move(req)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::send<T>, std::move(req), std::move(p));
+  });
+
+  return request_future.get();
+}
+
+template <typename T>
+td::Result<std::vector<GatherResult<typename T::ReturnType>>> MultiClient::gather(Request<T> req) const {
+  using ReturnType = std::vector<GatherResult<typename T::ReturnType>>;
+
+  std::promise<td::Result<ReturnType>> request_promise;
+  auto request_future = request_promise.get_future();
+
+  auto promise = td::Promise<ReturnType>([p = std::move(request_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), req = std::move(req)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::gather<T>, std::move(req), std::move(p));
+  });
+
+  return request_future.get();
+}
+
+template <typename T>
+td::Result<std::vector<typename T::ReturnType>> MultiClient::first_k(Request<T> req, size_t k) const {
+  using ReturnType = std::vector<typename T::ReturnType>;
+
+  std::promise<td::Result<ReturnType>> request_promise;
+  auto request_future = request_promise.get_future();
+
+  auto promise = td::Promise<ReturnType>([p = std::move(request_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), req = std::move(req), k]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::first_k<T>, std::move(req), k, std::move(p));
+  });
+
+  return request_future.get();
+}
+
 template <typename T>
 td::Result<typename T::ReturnType> MultiClient::send_request(Request<T> req) const {
   using ReturnType = typename T::ReturnType;
@@ -82,5 +249,38 @@ td::Result<typename T::ReturnType> MultiClient::send_request_function(RequestFun
   return request_future.get();
 }
 
+template <typename T>
+td::Result<typename T::ReturnType> MultiClient::send_lite_request(RequestLite<T> req) const {
+  using ReturnType = typename T::ReturnType;
+
+  std::promise<td::Result<ReturnType>> request_promise;
+  auto request_future = request_promise.get_future();
+
+  auto promise = td::Promise<ReturnType>([p = std::move(request_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), req = std::move(req)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::send_lite_request<T>, std::move(req), std::move(p));
+  });
+
+  return request_future.get();
+}
+
+template <typename R>
+td::Result<R> MultiClient::send_request_chain(RequestChain<R> chain) const {
+  std::promise<td::Result<R>> request_promise;
+  auto request_future = request_promise.get_future();
+
+  auto promise = td::Promise<R>([p = std::move(request_promise)](auto result) mutable {
+    p.set_value(std::move(result));
+  });
+
+  scheduler_->run_in_context_external([this, p = std::move(promise), chain = std::move(chain)]() mutable {
+    td::actor::send_closure(client_.get(), &MultiClientActor::send_request_chain<R>, std::move(chain), std::move(p));
+  });
+
+  return request_future.get();
+}
 
 }  // namespace multiclient
@@ -1,60 +1,28 @@
 #include "multi_client_actor.h"
 #include <algorithm>
 #include <cstdint>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <ranges>
 #include <string>
+#include <utility>
+#include <variant>
 #include "auto/tl/tonlib_api.h"
+#include "auto/tl/tonlib_api_json.h"
+#include "global_config.h"
 #include "request.h"
 #include "td/actor/PromiseFuture.h"
 #include "td/actor/actor.h"
 #include "td/utils/JsonBuilder.h"
 #include "td/utils/check.h"
 #include "td/utils/filesystem.h"
+#include "tl/tl_json.h"
 
 namespace multiclient {
 
 namespace {
 
-std::vector<std::string> split_global_config_by_liteservers(std::string global_config) {
-  auto config_json = td::json_decode(global_config).move_as_ok();
-  auto liteservers =
-      get_json_object_field(config_json.get_object(), "liteservers", td::JsonValue::Type::Array, false).move_as_ok();
-  const auto& ls_array = liteservers.get_array();
-
-  std::vector<std::string> result;
-  result.reserve(ls_array.size());
-
-  for (const auto& ls_json : ls_array) {
-    std::string result_ls_array;
-    {
-      td::JsonBuilder builder;
-      auto arr = builder.enter_array();
-      arr << ls_json;
-      arr.leave();
-      result_ls_array = builder.string_builder().as_cslice().str();
-    }
-
-    auto conf = td::json_decode(global_config).move_as_ok();
-
-    std::string result_config_str;
-    {
-      td::JsonBuilder builder;
-      auto obj = builder.enter_object();
-      obj("dht", get_json_object_field(conf.get_object(), "dht", td::JsonValue::Type::Object).move_as_ok());
-      obj("@type", get_json_object_field(conf.get_object(), "@type", td::JsonValue::Type::String).move_as_ok());
-      obj("validator", get_json_object_field(conf.get_object(), "validator", td::JsonValue::Type::Object).move_as_ok());
-      obj("liteservers", td::JsonRaw(result_ls_array));
-      obj.leave();
-      result_config_str = builder.string_builder().as_cslice().str();
-    }
-
-    result.push_back(std::move(result_config_str));
-  }
-
-  return result;
-}
-
 static auto kRandomDevice = std::random_device();
 static auto kRandomEngine = std::default_random_engine(kRandomDevice());
 
@@ -64,17 +32,51 @@ T get_random_index(T from, T to) {
   return distribution(kRandomEngine);
 }
 
+// TL function id of a JSON request, 0 if it does not parse.
+int32_t json_function_id(std::string request) {
+  auto json = td::json_decode(request);
+  if (json.is_error()) {
+    return 0;
+  }
+  tonlib_api::object_ptr<tonlib_api::Function> function;
+  if (td::from_json(function, json.move_as_ok()).is_error() || function == nullptr) {
+    return 0;
+  }
+  return function->get_id();
+}
+
 }  // namespace
 
 void MultiClientActor::send_request_json(RequestJson request, td::Promise<std::string> promise) {
-  auto worker_indices = select_workers(request.parameters);
+  if (should_park(request.parameters)) {
+    auto parameters = request.parameters;
+    park_request(
+        parameters,
+        std::move(promise),
+        [self_id = actor_id(this), request = std::move(request)](td::Promise<std::string> resumed) mutable {
+          td::actor::send_closure(
+              self_id, &MultiClientActor::send_request_json, std::move(request), std::move(resumed)
+          );
+        }
+    );
+    return;
+  }
+
+  // The function type is not known without parsing the JSON, which is done only when keystore requests have to be
+  // routed to the keystore owner; otherwise the request is charged the default cost.
+  auto function_id = key_store_owner_.has_value() ? json_function_id(request.request) : 0;
+  auto worker_indices = select_workers(request.parameters, function_id);
   if (worker_indices.empty()) {
     promise.set_error(td::Status::Error("No workers available"));
     return;
   }
-  auto multi_promise = PromiseSuccessAny<std::string>(std::move(promise));
+  auto leg_promise = combine_legs(request.parameters, worker_indices.size(), std::move(promise));
   for (auto worker_index : worker_indices) {
-    send_worker_request_json(worker_index, request.request, multi_promise.get_promise());
+    send_worker_request_json(
+        worker_index,
+        request.request,
+        track_request(worker_index, function_id, request.request.size(), leg_promise(worker_index))
+    );
   }
 }
 
@@ -84,7 +86,15 @@ void MultiClientActor::send_callback_request(RequestCallback request) {
 
   CHECK(callback_ != nullptr);
 
-  auto worker_indices = select_workers(request.parameters);
+  if ((request.request_id & kReservedRequestIdBit) != 0) {
+    callback_->on_error(
+        kUndefinedClientId, request.request_id, tonlib_api::make_object<tonlib_api::error>(400, "Reserved request id")
+    );
+    return;
+  }
+
+  auto function_id = key_store_owner_.has_value() ? request.request_creator()->get_id() : 0;
+  auto worker_indices = select_workers(request.parameters, function_id);
   if (worker_indices.empty()) {
     callback_->on_error(
         kUndefinedClientId, request.request_id, tonlib_api::make_object<tonlib_api::error>(400, "No workers available")
@@ -92,21 +102,336 @@ void MultiClientActor::send_callback_request(RequestCallback request) {
     return;
   }
 
+  auto request_id = request.request_id;
+  if (callback_combiner_ != nullptr && worker_indices.size() > 1) {
+    request_id = callback_combiner_->expect(request.request_id, worker_indices.size(), td::Time::now());
+  }
   for (auto worker_index : worker_indices) {
-    send_worker_callback_request(worker_index, request.request_id, request.request_creator());
+    send_worker_callback_request(worker_index, request_id, request.request_creator());
+  }
+}
+
+void MultiClientActor::resume_request_chain(td::Promise<td::Unit> continuation) {
+  continuation.set_value(td::Unit());
+}
+
+void MultiClientActor::on_request_chain_finished(uint64_t chain_id) {
+  request_chains_.erase(chain_id);
+}
+
+std::optional<size_t> MultiClientActor::chain_worker(uint64_t chain_id) {
+  auto it = request_chains_.find(chain_id);
+  if (it == request_chains_.end()) {
+    return std::nullopt;
+  }
+
+  auto& chain = it->second;
+  if (is_worker_suitable(chain.worker_index, chain.parameters)) {
+    return chain.worker_index;
+  }
+
+  auto worker_indices = select_workers(chain.parameters);
+  if (worker_indices.empty()) {
+    return std::nullopt;
+  }
+  LOG(DEBUG) << "request chain " << chain_id << " moves from LS #" << chain.worker_index << " to LS #"
+             << worker_indices.front();
+  chain.worker_index = worker_indices.front();
+  return chain.worker_index;
+}
+
+void MultiClientActor::start_block_scan(
+    BlockScanConfig config, std::unique_ptr<BlockScanCallback> callback, td::Promise<uint64_t> promise
+) {
+  if (callback == nullptr) {
+    promise.set_error(td::Status::Error("Block scan callback is required"));
+    return;
+  }
+  if (config.from_seqno > config.to_seqno) {
+    promise.set_error(td::Status::Error("Invalid block scan range"));
+    return;
+  }
+  if (config.parallelism == 0 || config.transactions_page_size <= 0) {
+    promise.set_error(td::Status::Error("Invalid block scan parallelism or page size"));
+    return;
+  }
+
+  auto scan_id = next_block_scan_id_++;
+  block_scanners_.emplace(
+      scan_id,
+      td::actor::create_actor<BlockScanner>(
+          td::actor::ActorOptions().with_name("multiclient_block_scanner_" + std::to_string(scan_id)),
+          scan_id,
+          actor_id(this),
+          std::move(config),
+          std::move(callback)
+      )
+  );
+  promise.set_value(std::move(scan_id));
+}
+
+void MultiClientActor::follow_blocks(
+    BlockFollowConfig config, std::unique_ptr<BlockScanCallback> callback, td::Promise<uint64_t> promise
+) {
+  if (callback == nullptr) {
+    promise.set_error(td::Status::Error("Block follow callback is required"));
+    return;
+  }
+  if (config.parallelism == 0 || config.transactions_page_size <= 0) {
+    promise.set_error(td::Status::Error("Invalid block follow parallelism or page size"));
+    return;
+  }
+
+  promise.set_value(create_block_follower(std::move(config), std::move(callback)));
+}
+
+uint64_t MultiClientActor::create_block_follower(
+    BlockFollowConfig config, std::unique_ptr<BlockScanCallback> callback
+) {
+  auto scan_id = next_block_scan_id_++;
+  block_scanners_.emplace(
+      scan_id,
+      td::actor::create_actor<BlockScanner>(
+          td::actor::ActorOptions().with_name("multiclient_block_follower_" + std::to_string(scan_id)),
+          scan_id,
+          actor_id(this),
+          std::move(config),
+          std::move(callback)
+      )
+  );
+  return scan_id;
+}
+
+void MultiClientActor::stop_block_scan(uint64_t scan_id) {
+  block_scanners_.erase(scan_id);
+  account_watch_sets_.erase(scan_id);
+}
+
+void MultiClientActor::on_block_scan_finished(uint64_t scan_id) {
+  block_scanners_.erase(scan_id);
+  account_watch_sets_.erase(scan_id);
+}
+
+void MultiClientActor::watch_accounts(
+    AccountWatchConfig config, std::unique_ptr<AccountWatchCallback> callback, td::Promise<uint64_t> promise
+) {
+  if (callback == nullptr) {
+    promise.set_error(td::Status::Error("Account watch callback is required"));
+    return;
+  }
+  if (config.parallelism == 0) {
+    promise.set_error(td::Status::Error("Invalid account watch parallelism"));
+    return;
+  }
+
+  auto watch_set = std::make_shared<AccountWatchSet>();
+  auto status = watch_set->add(config.addresses);
+  if (status.is_error()) {
+    promise.set_error(std::move(status));
+    return;
+  }
+
+  auto watch_id = create_block_follower(
+      BlockFollowConfig{
+          .from_seqno = config.from_seqno,
+          .parallelism = config.parallelism,
+          .with_shards = true,
+          .with_transactions = true,
+          .checkpoint_path = std::move(config.checkpoint_path),
+      },
+      std::make_unique<AccountWatcher>(watch_set, std::move(callback))
+  );
+  account_watch_sets_.emplace(watch_id, std::move(watch_set));
+  promise.set_value(std::move(watch_id));
+}
+
+void MultiClientActor::update_watched_accounts(
+    uint64_t watch_id, std::vector<std::string> added, std::vector<std::string> removed, td::Promise<td::Unit> promise
+) {
+  auto it = account_watch_sets_.find(watch_id);
+  if (it == account_watch_sets_.end()) {
+    promise.set_error(td::Status::Error("Unknown account watch"));
+    return;
+  }
+
+  auto status = it->second->add(added);
+  if (status.is_error()) {
+    promise.set_error(std::move(status));
+    return;
   }
+  it->second->remove(removed);
+  promise.set_value(td::Unit());
+}
+
+void MultiClientActor::refresh_pinned_accounts() {
+  if (!pinned_accounts_refresher_.empty()) {
+    td::actor::send_closure(pinned_accounts_refresher_, &PinnedAccountsRefresher::refresh);
+  }
+}
+
+void MultiClientActor::run_get_method(RequestGetMethod request, td::Promise<RunResultPtr> promise) {
+  static constexpr size_t kMaxSmcAffinityEntries = 1 << 20;
+
+  if (should_park(request.parameters)) {
+    auto parameters = request.parameters;
+    park_request(
+        parameters,
+        std::move(promise),
+        [self_id = actor_id(this), request = std::move(request)](td::Promise<RunResultPtr> resumed) mutable {
+          td::actor::send_closure(self_id, &MultiClientActor::run_get_method, std::move(request), std::move(resumed));
+        }
+    );
+    return;
+  }
+
+  std::vector<size_t> worker_indices;
+  bool use_affinity =
+      request.parameters.mode == RequestMode::Single && !request.parameters.lite_server_indexes.has_value();
+  if (use_affinity) {
+    auto it = smc_affinity_.find(request.address);
+    if (it != smc_affinity_.end() && request.parameters.are_valid() &&
+        is_worker_suitable(it->second, request.parameters) && !is_worker_saturated(it->second)) {
+      worker_indices.push_back(it->second);
+    }
+  }
+
+  if (worker_indices.empty()) {
+    worker_indices = select_workers(request.parameters, tonlib_api::smc_runGetMethod::ID);
+    if (worker_indices.empty()) {
+      promise.set_error(td::Status::Error("No workers available"));
+      return;
+    }
+    if (use_affinity) {
+      if (smc_affinity_.size() >= kMaxSmcAffinityEntries) {
+        smc_affinity_.clear();
+      }
+      smc_affinity_[request.address] = worker_indices.front();
+    }
+  }
+
+  auto leg_promise = combine_legs(request.parameters, worker_indices.size(), std::move(promise));
+  for (auto worker_index : worker_indices) {
+    auto stack = request.stack_creator != nullptr ? request.stack_creator() :
+                                                    std::vector<tonlib_api::object_ptr<tonlib_api::tvm_StackEntry>>{};
+    auto request_bytes = request.address.size() +
+        (std::holds_alternative<std::string>(request.method) ? std::get<std::string>(request.method).size() :
+                                                                sizeof(int32_t));
+    for (const auto& entry : stack) {
+      request_bytes += serialized_size(entry);
+    }
+    td::actor::send_closure(
+        workers_[worker_index].id,
+        &ClientWrapper::run_get_method,
+        request.address,
+        request.parameters.min_mc_seqno.value_or(workers_[worker_index].last_mc_seqno),
+        request.method,
+        std::move(stack),
+        track_request(worker_index, tonlib_api::smc_runGetMethod::ID, request_bytes, leg_promise(worker_index))
+    );
+  }
+}
+
+void MultiClientActor::run_get_method_locally(RequestGetMethod request, td::Promise<RunResultPtr> promise) {
+  td::actor::send_closure(local_get_method_runner_, &LocalGetMethodRunner::run, std::move(request), std::move(promise));
+}
+
+void MultiClientActor::run_get_methods(RequestGetMethodBatch batch, td::Promise<GetMethodBatchResults> promise) {
+  if (batch.parallelism == 0) {
+    promise.set_error(td::Status::Error("Invalid get-method batch parallelism"));
+    return;
+  }
+
+  auto batch_id = next_get_method_batch_id_++;
+  get_method_batches_.emplace(
+      batch_id,
+      td::actor::create_actor<GetMethodBatch>(
+          td::actor::ActorOptions().with_name("multiclient_get_method_batch_" + std::to_string(batch_id)),
+          batch_id,
+          actor_id(this),
+          std::move(batch),
+          std::move(promise)
+      )
+  );
+}
+
+void MultiClientActor::on_get_method_batch_finished(uint64_t batch_id) {
+  get_method_batches_.erase(batch_id);
+}
+
+void MultiClientActor::wait_for_mc_seqno(int32_t mc_seqno, td::Promise<int32_t> promise) {
+  auto head = cluster_mc_seqno();
+  if (head >= mc_seqno) {
+    promise.set_value(std::move(head));
+    return;
+  }
+  mc_seqno_waiters_.emplace(mc_seqno, std::move(promise));
+}
+
+void MultiClientActor::wait_for_seqno(int32_t mc_seqno, std::optional<double> timeout, td::Promise<int32_t> promise) {
+  if (!timeout.has_value() || cluster_mc_seqno() >= mc_seqno) {
+    wait_for_mc_seqno(mc_seqno, std::move(promise));
+    return;
+  }
+
+  // Both the waiter and the deadline run on the router, so whichever comes first resolves the promise unlocked and
+  // removes the other.
+  struct SeqnoWait {
+    td::Promise<int32_t> promise;
+    double deadline_at = 0;
+    uint64_t deadline_id = 0;
+  };
+  auto wait = std::make_shared<SeqnoWait>();
+  wait->promise = std::move(promise);
+  auto waiter = mc_seqno_waiters_.emplace(mc_seqno, [this, wait](td::Result<int32_t> result) {
+    if (!wait->promise) {
+      return;
+    }
+    // An error here means the router is being destroyed and the deadlines go with it.
+    bool is_ok = result.is_ok();
+    wait->promise.set_result(std::move(result));
+    if (is_ok) {
+      cancel_deadline(wait->deadline_at, wait->deadline_id);
+    }
+  });
+  auto deadline = td::Timestamp::in(*timeout);
+  wait->deadline_at = deadline.at();
+  wait->deadline_id = add_deadline(deadline, [this, wait, waiter, mc_seqno](td::Result<td::Unit> result) {
+    if (!wait->promise) {
+      return;
+    }
+    wait->promise.set_error(td::Status::Error("Timed out waiting for mc seqno " + std::to_string(mc_seqno)));
+    if (result.is_ok()) {
+      mc_seqno_waiters_.erase(waiter);
+    }
+  });
+}
+
+bool MultiClientActor::should_park(const RequestParameters& parameters) const {
+  return parameters.min_mc_seqno.has_value() && parameters.min_mc_seqno_wait.has_value() &&
+      cluster_mc_seqno() < *parameters.min_mc_seqno;
 }
 
 void MultiClientActor::start_up() {
   static constexpr double kFirstAlarmAfter = 1.0;
   static constexpr double kCheckArchivalForFirstTimeAfter = 22.0;
 
-  CHECK(std::filesystem::exists(config_.global_config_path));
+  if (callback_ != nullptr && config_.combine_callback_responses) {
+    callback_combiner_ = std::make_shared<CallbackCombiner>(callback_);
+    callback_ = callback_combiner_;
+  }
 
-  auto global_config = td::read_file_str(config_.global_config_path.string()).move_as_ok();
-  auto config_splitted_by_liteservers = split_global_config_by_liteservers(std::move(global_config));
+  std::string global_config;
+  if (config_.global_config.has_value()) {
+    global_config = *config_.global_config;
+  } else {
+    CHECK(std::filesystem::exists(config_.global_config_path));
+    global_config = td::read_file_str(config_.global_config_path.string()).move_as_ok();
+  }
 
-  CHECK(!config_splitted_by_liteservers.empty());
+  auto config_splitted_by_liteservers = split_global_config(std::move(global_config), config_.lite_servers);
+  if (config_splitted_by_liteservers.is_error()) {
+    LOG(FATAL) << "invalid global config: " << config_splitted_by_liteservers.error();
+  }
 
   if (config_.key_store_root.has_value()) {
     if (std::filesystem::exists(*config_.key_store_root)) {
@@ -117,50 +442,417 @@ void MultiClientActor::start_up() {
     }
   }
 
-  LOG(INFO) << "starting " << config_splitted_by_liteservers.size() << " client workers";
-
-  for (size_t client_index = 0; client_index < config_splitted_by_liteservers.size(); client_index++) {
-    workers_.push_back(WorkerInfo{
-        .id = td::actor::create_actor<ClientWrapper>(
-            td::actor::ActorOptions().with_name("multiclient_worker_" + std::to_string(client_index)).with_poll(),
-            client_index,
-            ClientConfig{
-                .global_config = config_splitted_by_liteservers[client_index],
-                .key_store = config_.key_store_root.has_value() ?
-                    std::make_optional<std::filesystem::path>(
-                        *config_.key_store_root / ("ls_" + std::to_string(client_index))
-                    ) :
-                    std::nullopt,
-                .blockchain_name = config_.blockchain_name,
-            },
-            callback_
-        ),
-    });
+  worker_global_configs_ = config_splitted_by_liteservers.move_as_ok();
+  workers_.resize(worker_global_configs_.size());
+
+  std::vector<size_t> initial_workers(workers_.size());
+  std::iota(initial_workers.begin(), initial_workers.end(), 0);
+  if (config_.elastic_min_workers.has_value()) {
+    std::shuffle(initial_workers.begin(), initial_workers.end(), kRandomEngine);
+    initial_workers.resize(std::min(std::max<size_t>(*config_.elastic_min_workers, 1), initial_workers.size()));
   }
 
-  alarm_timestamp() = td::Timestamp::in(kFirstAlarmAfter);
+  LOG(INFO) << "starting " << initial_workers.size() << " of " << workers_.size() << " client workers";
+
+  for (auto worker_index : initial_workers) {
+    start_worker(worker_index);
+  }
+
+  if (pinned_accounts_ != nullptr) {
+    pinned_accounts_refresher_ = td::actor::create_actor<PinnedAccountsRefresher>(
+        "multiclient_pinned_accounts", actor_id(this), pinned_accounts_
+    );
+  }
+
+  local_get_method_runner_ = td::actor::create_actor<LocalGetMethodRunner>(
+      "multiclient_local_get_method",
+      actor_id(this),
+      pinned_accounts_,
+      std::make_shared<CodeCache>(config_.local_code_cache_max_bytes),
+      config_.local_get_method_executors
+  );
+
+  next_health_check_ = td::Timestamp::in(kFirstAlarmAfter);
+  alarm_timestamp() = next_health_check_;
   next_archival_check_ = td::Timestamp::in(kCheckArchivalForFirstTimeAfter);
 }
 
+void MultiClientActor::start_worker(size_t worker_index) {
+  auto& worker = workers_[worker_index];
+  if (!worker.id.empty()) {
+    return;
+  }
+  const auto& global_config = worker_global_configs_[worker_index];
+
+  // The connection lives next to the worker, so a restarted `ClientWrapper` keeps using the same session.
+  bool use_owned_transport = config_.use_callbacks_for_network && !config_.lite_server_transport_factory;
+  if (worker.lite_server.empty() && (config_.direct_lite_server_queries || use_owned_transport)) {
+    auto lite_server_description = parse_lite_server(global_config);
+    if (lite_server_description.is_ok()) {
+      worker.lite_server = td::actor::create_actor<LiteServerConnection>(
+          "multiclient_lite_server_" + std::to_string(worker_index), worker_index, lite_server_description.move_as_ok()
+      );
+    } else {
+      LOG(ERROR) << "LS #" << worker_index << " has no direct connection: " << lite_server_description.error();
+    }
+  }
+
+  LOG(INFO) << "starting LS #" << worker_index << " worker";
+  if (config_.key_store_mode == KeyStoreMode::Shared && !key_store_owner_.has_value()) {
+    key_store_owner_ = worker_index;
+  }
+
+  std::shared_ptr<LiteServerTransport> transport;
+  if (config_.use_callbacks_for_network) {
+    if (config_.lite_server_transport_factory) {
+      transport = config_.lite_server_transport_factory(worker_index);
+    } else if (!worker.lite_server.empty()) {
+      transport = std::make_shared<LiteServerConnectionTransport>(worker.lite_server.get());
+    }
+  }
+
+  bool use_callbacks_for_network = transport != nullptr;
+  worker.id = td::actor::create_actor<ClientWrapper>(
+      td::actor::ActorOptions().with_name("multiclient_worker_" + std::to_string(worker_index)).with_poll(),
+      worker_index,
+      ClientConfig{
+          .global_config = global_config,
+          .key_store = worker_key_store(worker_index),
+          .blockchain_name = config_.blockchain_name,
+          .use_callbacks_for_network = use_callbacks_for_network,
+          .smc_cache_size = config_.smc_cache_size,
+      },
+      callback_,
+      std::move(transport)
+  );
+
+  worker.is_alive = false;
+  worker.is_waiting_for_update = false;
+  worker.check_retry_count = 0;
+  worker.check_retry_after = std::nullopt;
+  worker.last_used_at = td::Timestamp::now();
+  if (config_.adaptive_concurrency.has_value()) {
+    worker.concurrency = ConcurrencyLimiter(*config_.adaptive_concurrency);
+  }
+}
+
+std::optional<std::filesystem::path> MultiClientActor::worker_key_store(size_t worker_index) const {
+  if (!config_.key_store_root.has_value()) {
+    return std::nullopt;
+  }
+
+  switch (config_.key_store_mode) {
+    case KeyStoreMode::PerWorker:
+      return *config_.key_store_root / ("ls_" + std::to_string(worker_index));
+    case KeyStoreMode::Shared:
+      // `KeyValueDir` writes every entry through a fixed `<path>.tmp` file, so two clients saving the same entry
+      // (the last block state is saved on every new block) could overwrite each other's temporary file.
+      if (key_store_owner_ == worker_index) {
+        return *config_.key_store_root;
+      }
+      return std::nullopt;
+  }
+  return std::nullopt;
+}
+
+void MultiClientActor::stop_worker(size_t worker_index) {
+  auto& worker = workers_[worker_index];
+  LOG(INFO) << "retiring LS #" << worker_index << " worker";
+
+  worker.id.reset();
+  worker.is_alive = false;
+  worker.is_waiting_for_update = false;
+}
+
+void MultiClientActor::scale_workers() {
+  static constexpr double kScaleInterval = 5.0;
+  static constexpr double kDeadWorkerPenalty = 1000.0;
+
+  if (!config_.elastic_min_workers.has_value() || !next_scale_check_.is_in_past()) {
+    return;
+  }
+  next_scale_check_ = td::Timestamp::in(kScaleInterval);
+
+  const auto min_workers = std::max<size_t>(*config_.elastic_min_workers, 1);
+  size_t started_count = 0;
+  size_t alive_count = 0;
+  size_t in_flight = 0;
+  double latency_sum = 0;
+  std::optional<size_t> dead_worker;
+  std::optional<size_t> idle_worker;
+
+  for (size_t i = 0; i < workers_.size(); i++) {
+    const auto& worker = workers_[i];
+    if (worker.id.empty()) {
+      continue;
+    }
+    started_count++;
+
+    if (!worker.is_alive) {
+      if (worker.check_retry_count > config_.max_consecutive_alive_check_errors) {
+        dead_worker = i;
+      }
+      continue;
+    }
+    alive_count++;
+    in_flight += worker.in_flight;
+    latency_sum += worker.avg_latency;
+
+    bool is_idle =
+        worker.in_flight == 0 && td::Time::now() - worker.last_used_at.at() > config_.elastic_retire_idle_after;
+    if (is_idle && (!idle_worker.has_value() || worker.avg_latency > workers_[*idle_worker].avg_latency)) {
+      idle_worker = i;
+    }
+  }
+
+  if (dead_worker.has_value()) {
+    workers_[*dead_worker].failed_starts++;
+    stop_worker(*dead_worker);
+    started_count--;
+  }
+
+  bool is_overloaded = alive_count > 0 &&
+      (in_flight >= config_.elastic_scale_up_in_flight * alive_count ||
+       latency_sum / alive_count >= config_.elastic_scale_up_latency);
+
+  if ((alive_count < min_workers || is_overloaded) && started_count < workers_.size()) {
+    // Prefer workers that were fast before, then the ones never tried, then the slow and failing ones.
+    std::optional<size_t> best_worker;
+    double best_score = 0;
+    for (size_t i = 0; i < workers_.size(); i++) {
+      const auto& worker = workers_[i];
+      if (!worker.id.empty()) {
+        continue;
+      }
+      auto score = (worker.requests_count > 0 ? worker.avg_latency : config_.elastic_scale_up_latency / 2) +
+          kDeadWorkerPenalty * worker.failed_starts;
+      if (!best_worker.has_value() || score < best_score) {
+        best_worker = i;
+        best_score = score;
+      }
+    }
+
+    if (best_worker.has_value()) {
+      LOG(INFO) << "scaling up: " << alive_count << " alive workers, " << in_flight << " requests in flight";
+      start_worker(*best_worker);
+    }
+    return;
+  }
+
+  if (idle_worker.has_value() && alive_count > min_workers) {
+    stop_worker(*idle_worker);
+  }
+}
+
+void MultiClientActor::on_worker_request_finished(
+    size_t worker_index,
+    int32_t function_id,
+    double cost,
+    size_t reserved_bytes,
+    double latency,
+    SampleOutcome outcome,
+    size_t response_bytes
+) {
+  static constexpr double kLatencyWeight = 0.1;
+
+  bool is_ok = outcome == SampleOutcome::Success;
+
+  cost_model_.on_request_finished(function_id, latency, is_ok, response_bytes);
+
+  auto& worker = workers_[worker_index];
+  worker.outstanding_cost = std::max(0.0, worker.outstanding_cost - cost);
+  worker.in_flight_bytes -= std::min(worker.in_flight_bytes, reserved_bytes);
+
+  auto& profile = worker.method_profiles[function_id];
+  profile.avg_latency =
+      profile.requests_count == 0 ? latency : profile.avg_latency + kLatencyWeight * (latency - profile.avg_latency);
+  profile.error_rate += kLatencyWeight * ((is_ok ? 0.0 : 1.0) - profile.error_rate);
+  profile.requests_count++;
+  if (!is_ok) {
+    profile.errors_count++;
+  }
+  if (config_.adaptive_concurrency.has_value()) {
+    worker.concurrency.on_sample(td::Time::now(), function_id, latency, outcome, worker.in_flight);
+  }
+  if (worker.in_flight > 0) {
+    worker.in_flight--;
+  }
+  worker.avg_latency =
+      worker.requests_count == 0 ? latency : worker.avg_latency + kLatencyWeight * (latency - worker.avg_latency);
+  worker.requests_count++;
+  if (!is_ok) {
+    worker.errors_count++;
+  }
+}
+
+size_t MultiClientActor::WorkerInfo::memory_bytes() const {
+  return memory.total_bytes() + in_flight_bytes;
+}
+
+size_t MultiClientActor::WorkerInfo::capped_memory_bytes() const {
+  return memory_bytes() - memory.tonlib_base_bytes;
+}
+
+size_t MultiClientActor::total_capped_memory_bytes() const {
+  size_t result = 0;
+  for (const auto& worker : workers_) {
+    result += worker.capped_memory_bytes();
+  }
+  return result;
+}
+
+void MultiClientActor::check_memory() {
+  static constexpr double kMemoryCheckInterval = 5.0;
+
+  if (!next_memory_check_.is_in_past()) {
+    return;
+  }
+  next_memory_check_ = td::Timestamp::in(kMemoryCheckInterval);
+
+  for (size_t worker_index = 0; worker_index < workers_.size(); worker_index++) {
+    auto& worker = workers_[worker_index];
+    if (worker.id.empty()) {
+      worker.memory = WorkerMemoryUsage{};
+      worker.is_over_memory_cap = false;
+      continue;
+    }
+
+    td::actor::send_closure(
+        worker.id,
+        &ClientWrapper::get_memory_usage,
+        [self_id = actor_id(this), worker_index](td::Result<WorkerMemoryUsage> usage) {
+          td::actor::send_closure(self_id, &MultiClientActor::on_worker_memory_usage, worker_index, std::move(usage));
+        }
+    );
+  }
+}
+
+void MultiClientActor::on_worker_memory_usage(size_t worker_index, td::Result<WorkerMemoryUsage> usage) {
+  // A worker over its cap gets requests again only once it is below this share of the cap, so one near the cap does
+  // not flip in and out of routing on every check.
+  static constexpr double kMemoryCapLowWaterRatio = 0.8;
+
+  auto& worker = workers_[worker_index];
+  if (usage.is_error() || worker.id.empty()) {
+    return;
+  }
+  worker.memory = usage.move_as_ok();
+
+  if (!config_.worker_memory_cap_bytes.has_value()) {
+    return;
+  }
+
+  auto cap = *config_.worker_memory_cap_bytes;
+  auto memory_bytes = worker.capped_memory_bytes();
+  if (!worker.is_over_memory_cap && memory_bytes > cap) {
+    worker.is_over_memory_cap = true;
+    LOG(WARNING) << "LS #" << worker_index << " is over its memory cap: " << memory_bytes << " bytes";
+    td::actor::send_closure(worker.id, &ClientWrapper::trim_caches);
+  } else if (worker.is_over_memory_cap && memory_bytes <= static_cast<size_t>(cap * kMemoryCapLowWaterRatio)) {
+    worker.is_over_memory_cap = false;
+    LOG(INFO) << "LS #" << worker_index << " is back under its memory cap: " << memory_bytes << " bytes";
+  }
+}
+
+void MultiClientActor::get_worker_stats(td::Promise<std::vector<WorkerStats>> promise) {
+  std::vector<WorkerStats> result;
+  result.reserve(workers_.size());
+  for (size_t i = 0; i < workers_.size(); i++) {
+    const auto& worker = workers_[i];
+    result.push_back(WorkerStats{
+        .index = i,
+        .is_started = !worker.id.empty(),
+        .is_alive = worker.is_alive,
+        .is_archival = worker.is_archival,
+        .last_mc_seqno = worker.last_mc_seqno,
+        .in_flight = worker.in_flight,
+        .avg_latency = worker.avg_latency,
+        .requests_count = worker.requests_count,
+        .errors_count = worker.errors_count,
+        .memory = worker.memory,
+        .in_flight_bytes = worker.in_flight_bytes,
+        .is_over_memory_cap = worker.is_over_memory_cap,
+        .owns_key_store = key_store_owner_ == i,
+        .concurrency_limit = config_.adaptive_concurrency.has_value() ?
+            std::optional<size_t>(worker.concurrency.limit()) :
+            std::nullopt,
+        .latency_ratio = worker.concurrency.latency_ratio(),
+        .outstanding_cost = worker.outstanding_cost,
+        .method_profiles = worker.method_profiles,
+    });
+  }
+  promise.set_value(std::move(result));
+}
+
 void MultiClientActor::alarm() {
   static constexpr double kDefaultAlarmInterval = 1.0;
   static constexpr double kCheckArchivalInterval = 10 * 60.0;
+  static constexpr double kCallbackRequestTimeout = 120.0;
 
-  LOG(DEBUG) << "Checking alive workers";
-  check_alive();
+  fire_deadlines();
 
-  if (next_archival_check_.is_in_past()) {
-    LOG(DEBUG) << "Checking archival workers";
-    check_archival();
-    next_archival_check_ = td::Timestamp::in(kCheckArchivalInterval);
+  if (next_health_check_.is_in_past()) {
+    LOG(DEBUG) << "Checking alive workers";
+    check_alive();
+    if (callback_combiner_ != nullptr) {
+      callback_combiner_->expire(td::Time::now(), kCallbackRequestTimeout);
+    }
+    scale_workers();
+    check_memory();
+
+    if (next_archival_check_.is_in_past()) {
+      LOG(DEBUG) << "Checking archival workers";
+      check_archival();
+      next_archival_check_ = td::Timestamp::in(kCheckArchivalInterval);
+    }
+    next_health_check_ = td::Timestamp::in(kDefaultAlarmInterval);
   }
 
-  alarm_timestamp() = td::Timestamp::in(kDefaultAlarmInterval);
+  alarm_timestamp() = next_health_check_;
+  if (!deadlines_.empty()) {
+    alarm_timestamp().relax(td::Timestamp::at(deadlines_.begin()->first.first));
+  }
+}
+
+void MultiClientActor::schedule_deadline(td::Timestamp at, uint64_t deadline_id, td::Promise<td::Unit> on_deadline) {
+  deadlines_.emplace(std::make_pair(at.at(), deadline_id), std::move(on_deadline));
+  alarm_timestamp().relax(at);
+}
+
+uint64_t MultiClientActor::add_deadline(td::Timestamp at, td::Promise<td::Unit> on_deadline) {
+  auto deadline_id = next_deadline_id_++;
+  schedule_deadline(at, deadline_id, std::move(on_deadline));
+  return deadline_id;
+}
+
+void MultiClientActor::cancel_deadline(double at, uint64_t deadline_id) {
+  auto it = deadlines_.find(std::make_pair(at, deadline_id));
+  if (it == deadlines_.end()) {
+    return;
+  }
+  deadlines_.erase(it);
+
+  alarm_timestamp() = next_health_check_;
+  if (!deadlines_.empty()) {
+    alarm_timestamp().relax(td::Timestamp::at(deadlines_.begin()->first.first));
+  }
+}
+
+void MultiClientActor::fire_deadlines() {
+  auto now = td::Time::now();
+  while (!deadlines_.empty() && deadlines_.begin()->first.first <= now) {
+    auto promise = std::move(deadlines_.begin()->second);
+    deadlines_.erase(deadlines_.begin());
+    promise.set_value(td::Unit());
+  }
 }
 
 void MultiClientActor::check_alive() {
   for (size_t worker_index = 0; worker_index < workers_.size(); worker_index++) {
     auto& worker = workers_[worker_index];
+    if (worker.id.empty()) {
+      continue;
+    }
     if (worker.is_waiting_for_update) {
       LOG(DEBUG) << "LS #" << worker_index << " is waiting for update";
       continue;
@@ -217,6 +909,15 @@ void MultiClientActor::on_alive_checked(size_t worker_index, std::optional<int32
   } else {
     worker.check_retry_after = td::Timestamp::in(kRetryInterval);
   }
+
+  if (is_alive && !mc_seqno_waiters_.empty() && mc_seqno_waiters_.begin()->first <= last_mc_seqno_value) {
+    auto head = cluster_mc_seqno();
+    while (!mc_seqno_waiters_.empty() && mc_seqno_waiters_.begin()->first <= head) {
+      auto promise = std::move(mc_seqno_waiters_.begin()->second);
+      mc_seqno_waiters_.erase(mc_seqno_waiters_.begin());
+      promise.set_value(std::move(head));
+    }
+  }
 }
 
 void MultiClientActor::check_archival() {
@@ -253,28 +954,118 @@ void MultiClientActor::on_archival_checked(size_t worker_index, bool is_archival
   workers_[worker_index].is_archival = is_archival;
 }
 
-std::vector<size_t> MultiClientActor::select_workers(const RequestParameters& options) const {
+bool MultiClientActor::is_worker_suitable(size_t worker_index, const RequestParameters& options) const {
+  const auto& worker = workers_[worker_index];
+  return worker.is_alive && !worker.is_over_memory_cap && (options.archival == true ? worker.is_archival : true) &&
+      (options.min_mc_seqno.has_value() ? worker.last_mc_seqno >= *options.min_mc_seqno : true);
+}
+
+bool MultiClientActor::is_worker_saturated(size_t worker_index) const {
+  const auto& worker = workers_[worker_index];
+  return config_.adaptive_concurrency.has_value() && worker.in_flight >= worker.concurrency.limit();
+}
+
+double MultiClientActor::worker_score(size_t worker_index, RoutingPolicy routing, int32_t function_id) const {
+  static constexpr uint64_t kMinProfileSamples = 8;
+  static constexpr double kMinSuccessRate = 0.05;
+
+  const auto& worker = workers_[worker_index];
+  if (routing == RoutingPolicy::LeastLoaded) {
+    return worker.outstanding_cost;
+  }
+
+  // Expected time until the request is answered, counting retries of failures. Workers without enough samples get the
+  // cluster-wide estimate, so they are still tried.
+  double latency = cost_model_.estimate(function_id);
+  double error_rate = 0;
+  auto it = worker.method_profiles.find(function_id);
+  if (it != worker.method_profiles.end() && it->second.requests_count >= kMinProfileSamples) {
+    latency = it->second.avg_latency;
+    error_rate = it->second.error_rate;
+  }
+  return worker.outstanding_cost + latency / std::max(1 - error_rate, kMinSuccessRate);
+}
+
+size_t MultiClientActor::best_worker(
+    const std::vector<size_t>& worker_indices, RoutingPolicy routing, int32_t function_id
+) const {
+  static constexpr double kScoreEpsilon = 1e-6;
+
+  std::vector<double> scores;
+  scores.reserve(worker_indices.size());
+  for (auto worker_index : worker_indices) {
+    scores.push_back(worker_score(worker_index, routing, function_id));
+  }
+  auto min_score = *std::min_element(scores.begin(), scores.end());
+
+  // Random among the equally good ones, so an idle cluster still spreads requests.
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < worker_indices.size(); i++) {
+    if (scores[i] <= min_score + kScoreEpsilon) {
+      candidates.push_back(worker_indices[i]);
+    }
+  }
+  return candidates[get_random_index<size_t>(0, candidates.size() - 1)];
+}
+
+std::vector<size_t> MultiClientActor::select_workers(const RequestParameters& options, int32_t function_id) const {
   std::vector<size_t> result;
   if (!options.are_valid()) {
     LOG(WARNING) << "invalid request parameters";
     return result;
   }
 
+  if (config_.total_memory_cap_bytes.has_value() && total_capped_memory_bytes() > *config_.total_memory_cap_bytes) {
+    LOG(WARNING) << "rejecting request, memory cap is exceeded";
+    return result;
+  }
+
   result.reserve(workers_.size());
   for (size_t i : std::views::iota(0u, workers_.size()) |
-           std::views::filter([&](size_t i) { return workers_[i].is_alive; }) |
-           std::views::filter([&](size_t i) { return options.archival == true ? workers_[i].is_archival : true; })) {
+           std::views::filter([&](size_t i) { return is_worker_suitable(i, options); })) {
     result.push_back(i);
   }
+  if (key_store_owner_.has_value() && uses_key_store(function_id)) {
+    std::erase_if(result, [&](size_t i) { return i != *key_store_owner_; });
+  }
 
   if (result.empty()) {
     return result;
   }
 
+  if (options.prefer_archival) {
+    auto not_archival = std::stable_partition(result.begin(), result.end(), [&](size_t i) {
+      return workers_[i].is_archival;
+    });
+    if (not_archival != result.begin()) {
+      result.erase(not_archival, result.end());
+    }
+  }
+
+  // Saturated workers are used only when every suitable worker is at its limit.
+  auto saturated = std::stable_partition(result.begin(), result.end(), [&](size_t i) {
+    return !is_worker_saturated(i);
+  });
+  if (saturated != result.begin()) {
+    result.erase(saturated, result.end());
+  }
+
   switch (options.mode) {
     case RequestMode::Broadcast:
       return result;
 
+    case RequestMode::Gather:
+    case RequestMode::Freshest:
+    case RequestMode::FirstK: {
+      if (options.lite_server_indexes.has_value()) {
+        std::erase_if(result, [&](size_t i) {
+          return std::find(options.lite_server_indexes->begin(), options.lite_server_indexes->end(), i) ==
+              options.lite_server_indexes->end();
+        });
+      }
+      return result;
+    }
+
     case RequestMode::Single: {
       if (options.lite_server_indexes.has_value()) {
         return std::find(result.begin(), result.end(), options.lite_server_indexes->front()) != result.end() ?
@@ -282,7 +1073,7 @@ std::vector<size_t> MultiClientActor::select_workers(const RequestParameters& op
             std::vector<size_t>{};
       }
 
-      return std::vector<size_t>{result[get_random_index<size_t>(0, result.size() - 1)]};
+      return std::vector<size_t>{best_worker(result, options.routing, function_id)};
     }
 
     case RequestMode::Multiple: {
@@ -305,6 +1096,15 @@ std::vector<size_t> MultiClientActor::select_workers(const RequestParameters& op
       }
 
       std::shuffle(result.begin(), result.end(), kRandomEngine);
+      std::vector<std::pair<double, size_t>> scored;
+      scored.reserve(result.size());
+      for (auto worker_index : result) {
+        scored.emplace_back(worker_score(worker_index, options.routing, function_id), worker_index);
+      }
+      std::stable_sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+      for (size_t i = 0; i < scored.size(); i++) {
+        result[i] = scored[i].second;
+      }
       result.resize(std::min<size_t>(options.clients_number.value(), result.size()));
       return result;
     }
@@ -313,5 +1113,16 @@ std::vector<size_t> MultiClientActor::select_workers(const RequestParameters& op
   return result;
 }
 
+int32_t MultiClientActor::cluster_mc_seqno() const {
+  static constexpr int32_t kUndefinedLastMcSeqno = -1;
+
+  int32_t result = kUndefinedLastMcSeqno;
+  for (const auto& worker : workers_) {
+    if (worker.is_alive) {
+      result = std::max(result, worker.last_mc_seqno);
+    }
+  }
+  return result;
+}
 
 }  // namespace multiclient
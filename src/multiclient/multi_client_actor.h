@@ -1,15 +1,32 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <functional>
+#include <map>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include "account_watcher.h"
 #include "auto/tl/tonlib_api.h"
+#include "block_scanner.h"
+#include "callback_combiner.h"
 #include "client_wrapper.h"
+#include "concurrency_limiter.h"
+#include "get_method_batch.h"
+#include "global_config.h"
+#include "lite_server_connection.h"
+#include "local_get_method.h"
+#include "pinned_accounts.h"
 #include "promise.h"
 #include "request.h"
+#include "request_chain.h"
+#include "request_cost.h"
+#include "request_dispatch.h"
 #include "response_callback.h"
+#include "serialized_size.h"
 #include "td/actor/ActorOwn.h"
 #include "td/actor/PromiseFuture.h"
 #include "td/actor/common.h"
@@ -17,19 +34,93 @@
 
 namespace multiclient {
 
+enum class KeyStoreMode : uint8_t {
+  // Every worker gets its own `key_store_root / "ls_N"` directory.
+  PerWorker,
+  // One keystore in `key_store_root`, written by a single worker (`WorkerStats::owns_key_store`); the other workers
+  // keep their chain state in memory. Tonlib's directory keystore is not safe for concurrent writers. Requests that
+  // use the keystore (`uses_key_store`) are routed to the owner, so every client sees the same keys.
+  Shared,
+};
+
 struct MultiClientActorConfig {
   std::filesystem::path global_config_path;
+  std::optional<std::string> global_config = std::nullopt;
+  std::vector<LiteServerConfig> lite_servers = {};
   std::optional<std::filesystem::path> key_store_root;
   std::string blockchain_name = "mainnet";
   bool reset_key_store = false;
+  KeyStoreMode key_store_mode = KeyStoreMode::PerWorker;
 
   size_t max_consecutive_alive_check_errors = 10;
+  size_t local_get_method_executors = 1;
+  size_t local_code_cache_max_bytes = 64 << 20;
+  size_t smc_cache_size = 1024;
+  bool direct_lite_server_queries = false;
+  bool use_callbacks_for_network = false;
+  LiteServerTransportFactory lite_server_transport_factory = nullptr;
+  bool combine_callback_responses = true;
+
+  // When set, only this many workers are started and more are added while the running ones are overloaded.
+  std::optional<size_t> elastic_min_workers = std::nullopt;
+  size_t elastic_scale_up_in_flight = 16;
+  double elastic_scale_up_latency = 2.0;
+  double elastic_retire_idle_after = 300.0;
+
+  // A worker above its cap gets no new requests and its caches are trimmed; above the total cap requests are rejected.
+  std::optional<size_t> worker_memory_cap_bytes = std::nullopt;
+  std::optional<size_t> total_memory_cap_bytes = std::nullopt;
+
+  // When set, every worker gets an adaptive in-flight limit and requests prefer workers below it.
+  std::optional<ConcurrencyLimiterConfig> adaptive_concurrency = std::nullopt;
+};
+
+// Latency and errors of one worker for one TL function type.
+struct MethodProfile {
+  double avg_latency = 0;
+  // Exponentially weighted share of failed requests.
+  double error_rate = 0;
+  uint64_t requests_count = 0;
+  uint64_t errors_count = 0;
+};
+
+struct WorkerStats {
+  size_t index = 0;
+  bool is_started = false;
+  bool is_alive = false;
+  bool is_archival = false;
+  int32_t last_mc_seqno = -1;
+  size_t in_flight = 0;
+  double avg_latency = 0;
+  uint64_t requests_count = 0;
+  uint64_t errors_count = 0;
+
+  WorkerMemoryUsage memory;
+  // Serialized size of the requests queued or running in the worker, plus the average serialized size of the
+  // responses of their TL functions so far.
+  size_t in_flight_bytes = 0;
+  bool is_over_memory_cap = false;
+  // The worker writing the shared keystore in `KeyStoreMode::Shared`.
+  bool owns_key_store = false;
+
+  // Current adaptive in-flight limit, if `adaptive_concurrency` is enabled, and the latency of the last request
+  // relative to the no-load latency of its TL function that the limit is based on.
+  std::optional<size_t> concurrency_limit = std::nullopt;
+  double latency_ratio = 0;
+  // Estimated seconds of lite server work queued on the worker, see `RequestCostModel`.
+  double outstanding_cost = 0;
+  // Keyed by TL function id.
+  std::unordered_map<int32_t, MethodProfile> method_profiles;
 };
 
 class MultiClientActor : public td::actor::Actor {
 public:
-  explicit MultiClientActor(MultiClientActorConfig config, std::unique_ptr<ResponseCallback> callback = nullptr) :
-      config_(std::move(config)), callback_(callback.release()) {
+  explicit MultiClientActor(
+      MultiClientActorConfig config,
+      std::shared_ptr<ResponseCallback> callback = nullptr,
+      std::shared_ptr<PinnedAccountStore> pinned_accounts = nullptr
+  ) :
+      config_(std::move(config)), callback_(std::move(callback)), pinned_accounts_(std::move(pinned_accounts)) {
   }
 
   void start_up() final;
@@ -41,9 +132,79 @@ public:
   template <typename T>
   void send_request_function(RequestFunction<T> req, td::Promise<typename T::ReturnType>);
 
+  template <typename T>
+  void send_lite_request(RequestLite<T> request, td::Promise<typename T::ReturnType> promise);
+
+  // Picks `send_request` or `send_request_function` for `T` at compile time, see `RequestDispatchTraits`.
+  template <typename T>
+  void send(Request<T> request, td::Promise<typename T::ReturnType> promise);
+
+  template <typename T>
+  void gather(Request<T> request, td::Promise<std::vector<GatherResult<typename T::ReturnType>>> promise);
+
+  template <typename T>
+  void first_k(Request<T> request, size_t k, td::Promise<std::vector<typename T::ReturnType>> promise);
+
   void send_request_json(RequestJson request, td::Promise<std::string> promise);
   void send_callback_request(RequestCallback request);
 
+  template <typename R>
+  void send_request_chain(RequestChain<R> chain, td::Promise<R> promise);
+
+  template <typename T>
+  void send_chain_request(uint64_t chain_id, T request, td::Promise<typename T::ReturnType> promise);
+
+  template <typename T>
+  void send_chain_request_function(
+      uint64_t chain_id, ton::tonlib_api::object_ptr<T> request, td::Promise<typename T::ReturnType> promise
+  );
+
+  void resume_request_chain(td::Promise<td::Unit> continuation);
+  void on_request_chain_finished(uint64_t chain_id);
+
+  void start_block_scan(
+      BlockScanConfig config, std::unique_ptr<BlockScanCallback> callback, td::Promise<uint64_t> promise
+  );
+  void follow_blocks(
+      BlockFollowConfig config, std::unique_ptr<BlockScanCallback> callback, td::Promise<uint64_t> promise
+  );
+  void stop_block_scan(uint64_t scan_id);
+  void on_block_scan_finished(uint64_t scan_id);
+
+  void watch_accounts(
+      AccountWatchConfig config, std::unique_ptr<AccountWatchCallback> callback, td::Promise<uint64_t> promise
+  );
+  void update_watched_accounts(
+      uint64_t watch_id,
+      std::vector<std::string> added,
+      std::vector<std::string> removed,
+      td::Promise<td::Unit> promise
+  );
+
+  void refresh_pinned_accounts();
+
+  void run_get_method(RequestGetMethod request, td::Promise<RunResultPtr> promise);
+  void run_get_method_locally(RequestGetMethod request, td::Promise<RunResultPtr> promise);
+  void run_get_methods(RequestGetMethodBatch batch, td::Promise<GetMethodBatchResults> promise);
+  void on_get_method_batch_finished(uint64_t batch_id);
+
+  // Resolves with the cluster head as soon as any alive worker reports a masterchain seqno >= `mc_seqno`.
+  void wait_for_mc_seqno(int32_t mc_seqno, td::Promise<int32_t> promise);
+  // Same as `wait_for_mc_seqno`, failing after `timeout` seconds if it is set.
+  void wait_for_seqno(int32_t mc_seqno, std::optional<double> timeout, td::Promise<int32_t> promise);
+
+  void get_worker_stats(td::Promise<std::vector<WorkerStats>> promise);
+  void on_worker_request_finished(
+      size_t worker_index,
+      int32_t function_id,
+      double cost,
+      size_t reserved_bytes,
+      double latency,
+      SampleOutcome outcome,
+      size_t response_bytes
+  );
+  void on_worker_memory_usage(size_t worker_index, td::Result<WorkerMemoryUsage> usage);
+
   size_t worker_count() const {
     return workers_.size();
   }
@@ -51,6 +212,7 @@ public:
 private:
   struct WorkerInfo {
     td::actor::ActorOwn<ClientWrapper> id;
+    td::actor::ActorOwn<LiteServerConnection> lite_server;
     bool is_alive = false;
     bool is_archival = false;
     int32_t last_mc_seqno = -1;
@@ -58,8 +220,70 @@ private:
     bool is_waiting_for_update = false;
     size_t check_retry_count = 0;
     std::optional<td::Timestamp> check_retry_after = std::nullopt;
+
+    size_t in_flight = 0;
+    // Serialized size of the requests in flight and the expected size of their responses, see `track_request`.
+    size_t in_flight_bytes = 0;
+    double avg_latency = 0;
+    uint64_t requests_count = 0;
+    uint64_t errors_count = 0;
+    size_t failed_starts = 0;
+    td::Timestamp last_used_at;
+
+    WorkerMemoryUsage memory;
+    bool is_over_memory_cap = false;
+    ConcurrencyLimiter concurrency;
+    // Sum of the estimated costs of the requests in flight.
+    double outstanding_cost = 0;
+    std::unordered_map<int32_t, MethodProfile> method_profiles;
+
+    size_t memory_bytes() const;
+    // What the memory caps apply to: `memory_bytes` without the fixed base of the client.
+    size_t capped_memory_bytes() const;
   };
 
+  struct RequestChainInfo {
+    RequestParameters parameters;
+    size_t worker_index = 0;
+  };
+
+  // Counts the request against the worker's in-flight, cost, memory and latency statistics. `request_bytes` is the
+  // `serialized_size` of the request; its response is reserved at the size the function's responses have had so far
+  // and measured when it arrives.
+  template <typename R>
+  td::Promise<R> track_request(
+      size_t worker_index, int32_t function_id, size_t request_bytes, td::Promise<R> promise
+  ) {
+    auto& worker = workers_[worker_index];
+    auto cost = cost_model_.estimate(function_id);
+    auto reserved_bytes = request_bytes + cost_model_.expected_response_bytes(function_id);
+    worker.in_flight++;
+    worker.in_flight_bytes += reserved_bytes;
+    worker.outstanding_cost += cost;
+    worker.last_used_at = td::Timestamp::now();
+
+    return [self_id = actor_id(this),
+            worker_index,
+            function_id,
+            cost,
+            reserved_bytes,
+            started_at = td::Time::now(),
+            promise = std::move(promise)](td::Result<R> result) mutable {
+      td::actor::send_closure(
+          self_id,
+          &MultiClientActor::on_worker_request_finished,
+          worker_index,
+          function_id,
+          cost,
+          reserved_bytes,
+          td::Time::now() - started_at,
+          result.is_ok() ? SampleOutcome::Success : classify_error(result.error()),
+          result.is_ok() ? serialized_size(result.ok()) : 0
+      );
+      promise.set_result(std::move(result));
+    };
+  }
+
   template <typename T>
   void send_worker_request(size_t worker_index, T&& request, td::Promise<typename T::ReturnType> promise) {
     td::actor::send_closure(
@@ -90,7 +314,106 @@ private:
     );
   }
 
-  std::vector<size_t> select_workers(const RequestParameters& options) const;
+  // Hands the result back to the router before resolving `promise`, so chain steps always run on the router.
+  template <typename R>
+  td::Promise<R> resume_in_router(td::Promise<R> promise) {
+    return [self_id = actor_id(this), promise = std::move(promise)](td::Result<R> result) mutable {
+      auto continuation = [promise = std::move(promise), result = std::move(result)](td::Result<td::Unit>) mutable {
+        promise.set_result(std::move(result));
+      };
+      td::actor::send_closure(
+          self_id, &MultiClientActor::resume_request_chain, td::Promise<td::Unit>(std::move(continuation))
+      );
+    };
+  }
+
+  std::optional<size_t> chain_worker(uint64_t chain_id);
+
+  // Returns the promise of each leg of a request sent to several workers; the legs are combined as its mode asks.
+  template <typename R>
+  std::function<td::Promise<R>(size_t)> combine_legs(
+      const RequestParameters& parameters, size_t legs, td::Promise<R> promise
+  ) {
+    if (parameters.mode == RequestMode::Freshest) {
+      // The window opens on whichever thread answers first, so its deadline id is reserved here on the router.
+      auto deadline_id = next_deadline_id_++;
+      auto freshest = PromiseFreshest<R>(
+          std::move(promise),
+          legs,
+          cluster_mc_seqno(),
+          parameters.freshness_window,
+          [self_id = actor_id(this), deadline_id](td::Timestamp at, td::Promise<td::Unit> on_deadline) {
+            td::actor::send_closure(
+                self_id, &MultiClientActor::schedule_deadline, at, deadline_id, std::move(on_deadline)
+            );
+          },
+          [self_id = actor_id(this), deadline_id](td::Timestamp at) {
+            td::actor::send_closure(self_id, &MultiClientActor::cancel_deadline, at.at(), deadline_id);
+          }
+      );
+      return [this, freshest](size_t worker_index) mutable {
+        return freshest.get_promise(workers_[worker_index].last_mc_seqno);
+      };
+    }
+
+    auto success_any = PromiseSuccessAny<R>(std::move(promise), legs);
+    return [success_any](size_t) mutable { return success_any.get_promise(); };
+  }
+
+  // Adds a deadline under an id taken from `next_deadline_id_` beforehand, for deadlines set off the router.
+  void schedule_deadline(td::Timestamp at, uint64_t deadline_id, td::Promise<td::Unit> on_deadline);
+  // Same as `schedule_deadline`, returning a fresh id for `cancel_deadline`. A cancelled deadline's promise is
+  // destroyed, so it gets an error instead of firing.
+  uint64_t add_deadline(td::Timestamp at, td::Promise<td::Unit> on_deadline);
+  void cancel_deadline(double at, uint64_t deadline_id);
+  void fire_deadlines();
+
+  bool should_park(const RequestParameters& parameters) const;
+
+  // Holds a request until some worker reaches `parameters.min_mc_seqno`, then hands `promise` to `resend`. Parked
+  // requests are released by the health checks, so nothing is polled per request.
+  template <typename R, typename F>
+  void park_request(const RequestParameters& parameters, td::Promise<R> promise, F resend) {
+    wait_for_seqno(
+        *parameters.min_mc_seqno,
+        parameters.min_mc_seqno_wait,
+        [promise = std::move(promise), resend = std::move(resend)](td::Result<int32_t> result) mutable {
+          if (result.is_error()) {
+            promise.set_error(result.move_as_error());
+            return;
+          }
+          resend(std::move(promise));
+        }
+    );
+  }
+
+  // Sends `request` to one worker over the dispatch path chosen by `RequestDispatchTraits<T>`.
+  template <typename T>
+  void send_worker_typed_request(size_t worker_index, T&& request, td::Promise<typename T::ReturnType> promise) {
+    if constexpr (RequestDispatchTraits<T>::path == DispatchPath::MakeRequest) {
+      send_worker_request<T>(worker_index, std::move(request), std::move(promise));
+    } else {
+      send_worker_request_function<T>(
+          worker_index, ton::tonlib_api::make_object<T>(std::move(request)), std::move(promise)
+      );
+    }
+  }
+
+  void start_worker(size_t worker_index);
+  std::optional<std::filesystem::path> worker_key_store(size_t worker_index) const;
+  void stop_worker(size_t worker_index);
+  void scale_workers();
+  void check_memory();
+  size_t total_capped_memory_bytes() const;
+
+  uint64_t create_block_follower(BlockFollowConfig config, std::unique_ptr<BlockScanCallback> callback);
+
+  bool is_worker_suitable(size_t worker_index, const RequestParameters& options) const;
+  bool is_worker_saturated(size_t worker_index) const;
+  std::vector<size_t> select_workers(const RequestParameters& options, int32_t function_id = 0) const;
+  double worker_score(size_t worker_index, RoutingPolicy routing, int32_t function_id) const;
+  size_t best_worker(const std::vector<size_t>& worker_indices, RoutingPolicy routing, int32_t function_id) const;
+  int32_t cluster_mc_seqno() const;
 
   void check_alive();
   void on_alive_checked(size_t worker_index, std::optional<int32_t> last_mc_seqno);
@@ -100,37 +423,319 @@ private:
 
   const MultiClientActorConfig config_;
   std::shared_ptr<ResponseCallback> callback_;
+  std::shared_ptr<CallbackCombiner> callback_combiner_;
+  std::shared_ptr<PinnedAccountStore> pinned_accounts_;
+  std::vector<std::string> worker_global_configs_;
   std::vector<WorkerInfo> workers_;
+  // The first worker started in `KeyStoreMode::Shared`; only it ever opens `key_store_root`.
+  std::optional<size_t> key_store_owner_;
+  RequestCostModel cost_model_;
+  td::Timestamp next_health_check_ = td::Timestamp::now();
+  td::Timestamp next_scale_check_ = td::Timestamp::now();
+  td::Timestamp next_memory_check_ = td::Timestamp::now();
   td::Timestamp next_archival_check_ = td::Timestamp::now();
   uint64_t json_request_id_ = 11;
+
+  std::unordered_map<uint64_t, td::actor::ActorOwn<BlockScanner>> block_scanners_;
+  uint64_t next_block_scan_id_ = 1;
+  std::unordered_map<uint64_t, std::shared_ptr<AccountWatchSet>> account_watch_sets_;
+  td::actor::ActorOwn<PinnedAccountsRefresher> pinned_accounts_refresher_;
+  td::actor::ActorOwn<LocalGetMethodRunner> local_get_method_runner_;
+  // Worker that last loaded an address with `smc_load`, so repeated get-methods reuse its handle.
+  std::unordered_map<std::string, size_t> smc_affinity_;
+  std::unordered_map<uint64_t, td::actor::ActorOwn<GetMethodBatch>> get_method_batches_;
+  uint64_t next_get_method_batch_id_ = 1;
+  std::multimap<int32_t, td::Promise<int32_t>> mc_seqno_waiters_;
+  std::unordered_map<uint64_t, RequestChainInfo> request_chains_;
+  // Request deadlines by the `td::Time` at which they fire and id; the alarm is kept at or before the earliest one.
+  std::map<std::pair<double, uint64_t>, td::Promise<td::Unit>> deadlines_;
+  uint64_t next_deadline_id_ = 1;
+  uint64_t next_request_chain_id_ = 1;
 };
 
 template <typename T>
 void MultiClientActor::send_request(Request<T> request, td::Promise<typename T::ReturnType> promise) {
-  auto worker_indices = select_workers(request.parameters);
+  if (should_park(request.parameters)) {
+    auto parameters = request.parameters;
+    park_request(
+        parameters,
+        std::move(promise),
+        [self_id = actor_id(this), request = std::move(request)](auto resumed) mutable {
+          td::actor::send_closure(self_id, &MultiClientActor::send_request<T>, std::move(request), std::move(resumed));
+        }
+    );
+    return;
+  }
+
+  auto worker_indices = select_workers(request.parameters, T::ID);
   if (worker_indices.empty()) {
     promise.set_error(td::Status::Error("No workers available"));
     return;
   }
 
-  auto multi_promise = PromiseSuccessAny<typename T::ReturnType>(std::move(promise));
+  auto leg_promise = combine_legs(request.parameters, worker_indices.size(), std::move(promise));
   for (auto worker_index : worker_indices) {
-    send_worker_request<T>(worker_index, request.request_creator(), multi_promise.get_promise());
+    auto tl_request = request.request_creator();
+    auto request_bytes = serialized_size(tl_request);
+    send_worker_request<T>(
+        worker_index,
+        std::move(tl_request),
+        track_request(worker_index, T::ID, request_bytes, leg_promise(worker_index))
+    );
   }
 }
 
 template <typename T>
 void MultiClientActor::send_request_function(RequestFunction<T> request, td::Promise<typename T::ReturnType> promise) {
-  auto worker_indices = select_workers(request.parameters);
+  if (should_park(request.parameters)) {
+    auto parameters = request.parameters;
+    park_request(
+        parameters,
+        std::move(promise),
+        [self_id = actor_id(this), request = std::move(request)](auto resumed) mutable {
+          td::actor::send_closure(
+              self_id, &MultiClientActor::send_request_function<T>, std::move(request), std::move(resumed)
+          );
+        }
+    );
+    return;
+  }
+
+  auto worker_indices = select_workers(request.parameters, T::ID);
+  if (worker_indices.empty()) {
+    promise.set_error(td::Status::Error("No workers available"));
+    return;
+  }
+
+  auto leg_promise = combine_legs(request.parameters, worker_indices.size(), std::move(promise));
+  for (auto worker_index : worker_indices) {
+    auto tl_request = request.request_creator();
+    auto request_bytes = serialized_size(tl_request);
+    send_worker_request_function<T>(
+        worker_index,
+        std::move(tl_request),
+        track_request(worker_index, T::ID, request_bytes, leg_promise(worker_index))
+    );
+  }
+}
+
+template <typename T>
+void MultiClientActor::send_lite_request(RequestLite<T> request, td::Promise<typename T::ReturnType> promise) {
+  if (!config_.direct_lite_server_queries && !config_.use_callbacks_for_network) {
+    promise.set_error(td::Status::Error("Direct lite server queries are disabled"));
+    return;
+  }
+
+  if (should_park(request.parameters)) {
+    auto parameters = request.parameters;
+    park_request(
+        parameters,
+        std::move(promise),
+        [self_id = actor_id(this), request = std::move(request)](auto resumed) mutable {
+          td::actor::send_closure(
+              self_id, &MultiClientActor::send_lite_request<T>, std::move(request), std::move(resumed)
+          );
+        }
+    );
+    return;
+  }
+
+  auto worker_indices = select_workers(request.parameters, T::ID);
+  std::erase_if(worker_indices, [&](size_t worker_index) { return workers_[worker_index].lite_server.empty(); });
+  if (worker_indices.empty()) {
+    promise.set_error(td::Status::Error("No workers available"));
+    return;
+  }
+
+  auto leg_promise = combine_legs(request.parameters, worker_indices.size(), std::move(promise));
+  for (auto worker_index : worker_indices) {
+    auto lite_request = request.request_creator();
+    auto request_bytes = serialized_size(lite_request);
+    td::actor::send_closure(
+        workers_[worker_index].lite_server,
+        &LiteServerConnection::send_query<T>,
+        std::move(lite_request),
+        track_request(worker_index, T::ID, request_bytes, leg_promise(worker_index))
+    );
+  }
+}
+
+template <typename T>
+void MultiClientActor::send(Request<T> request, td::Promise<typename T::ReturnType> promise) {
+  if constexpr (RequestDispatchTraits<T>::path == DispatchPath::MakeRequest) {
+    send_request<T>(std::move(request), std::move(promise));
+  } else {
+    send_request_function<T>(
+        RequestFunction<T>{
+            .parameters = std::move(request.parameters),
+            .request_creator =
+                [creator = std::move(request.request_creator)]() {
+                  return ton::tonlib_api::make_object<T>(creator());
+                },
+        },
+        std::move(promise)
+    );
+  }
+}
+
+template <typename T>
+void MultiClientActor::gather(
+    Request<T> request, td::Promise<std::vector<GatherResult<typename T::ReturnType>>> promise
+) {
+  if (should_park(request.parameters)) {
+    auto parameters = request.parameters;
+    park_request(
+        parameters,
+        std::move(promise),
+        [self_id = actor_id(this), request = std::move(request)](auto resumed) mutable {
+          td::actor::send_closure(self_id, &MultiClientActor::gather<T>, std::move(request), std::move(resumed));
+        }
+    );
+    return;
+  }
+
+  auto worker_indices = select_workers(request.parameters, T::ID);
   if (worker_indices.empty()) {
     promise.set_error(td::Status::Error("No workers available"));
     return;
   }
 
-  auto multi_promise = PromiseSuccessAny<typename T::ReturnType>(std::move(promise));
+  // A worker that never answers would otherwise hold the caller forever.
+  static constexpr double kDefaultGatherTimeout = 60.0;
+
+  auto gather_promise = PromiseGather<typename T::ReturnType>(worker_indices, std::move(promise));
+  auto deadline = td::Timestamp::in(request.parameters.timeout.value_or(kDefaultGatherTimeout));
+  auto deadline_id = add_deadline(deadline, gather_promise.get_deadline_promise());
+  gather_promise.set_on_finish([self_id = actor_id(this), at = deadline.at(), deadline_id] {
+    td::actor::send_closure(self_id, &MultiClientActor::cancel_deadline, at, deadline_id);
+  });
+  for (size_t i = 0; i < worker_indices.size(); i++) {
+    auto tl_request = request.request_creator();
+    auto request_bytes = serialized_size(tl_request);
+    send_worker_typed_request<T>(
+        worker_indices[i],
+        std::move(tl_request),
+        track_request(worker_indices[i], T::ID, request_bytes, gather_promise.get_promise(i))
+    );
+  }
+}
+
+template <typename T>
+void MultiClientActor::first_k(
+    Request<T> request, size_t k, td::Promise<std::vector<typename T::ReturnType>> promise
+) {
+  if (k == 0) {
+    promise.set_value(std::vector<typename T::ReturnType>{});
+    return;
+  }
+
+  if (should_park(request.parameters)) {
+    auto parameters = request.parameters;
+    park_request(
+        parameters,
+        std::move(promise),
+        [self_id = actor_id(this), request = std::move(request), k](auto resumed) mutable {
+          td::actor::send_closure(self_id, &MultiClientActor::first_k<T>, std::move(request), k, std::move(resumed));
+        }
+    );
+    return;
+  }
+
+  auto worker_indices = select_workers(request.parameters, T::ID);
+  if (worker_indices.size() < k) {
+    promise.set_error(td::Status::Error(
+        "Not enough workers available: " + std::to_string(worker_indices.size()) + " of " + std::to_string(k)
+    ));
+    return;
+  }
+
+  auto first_k_promise = PromiseFirstK<typename T::ReturnType>(std::move(promise), worker_indices.size(), k);
   for (auto worker_index : worker_indices) {
-    send_worker_request_function<T>(worker_index, request.request_creator(), multi_promise.get_promise());
+    auto tl_request = request.request_creator();
+    auto request_bytes = serialized_size(tl_request);
+    send_worker_typed_request<T>(
+        worker_index,
+        std::move(tl_request),
+        track_request(worker_index, T::ID, request_bytes, first_k_promise.get_promise())
+    );
+  }
+}
+
+template <typename R>
+void MultiClientActor::send_request_chain(RequestChain<R> chain, td::Promise<R> promise) {
+  if (chain.parameters.mode != RequestMode::Single) {
+    promise.set_error(td::Status::Error("Request chains support only RequestMode::Single"));
+    return;
+  }
+
+  auto worker_indices = select_workers(chain.parameters);
+  if (worker_indices.empty()) {
+    promise.set_error(td::Status::Error("No workers available"));
+    return;
+  }
+
+  auto chain_id = next_request_chain_id_++;
+  request_chains_.emplace(
+      chain_id, RequestChainInfo{.parameters = chain.parameters, .worker_index = worker_indices.front()}
+  );
+
+  chain.start(
+      RequestChainContext(actor_id(this), chain_id),
+      [self_id = actor_id(this), chain_id, promise = std::move(promise)](td::Result<R> result) mutable {
+        td::actor::send_closure(self_id, &MultiClientActor::on_request_chain_finished, chain_id);
+        promise.set_result(std::move(result));
+      }
+  );
+}
+
+template <typename T>
+void MultiClientActor::send_chain_request(
+    uint64_t chain_id, T request, td::Promise<typename T::ReturnType> promise
+) {
+  auto worker_index = chain_worker(chain_id);
+  if (!worker_index.has_value()) {
+    promise.set_error(td::Status::Error("No workers available"));
+    return;
   }
+  auto request_bytes = serialized_size(request);
+  send_worker_request<T>(
+      *worker_index,
+      std::move(request),
+      track_request(*worker_index, T::ID, request_bytes, resume_in_router(std::move(promise)))
+  );
+}
+
+template <typename T>
+void MultiClientActor::send_chain_request_function(
+    uint64_t chain_id, ton::tonlib_api::object_ptr<T> request, td::Promise<typename T::ReturnType> promise
+) {
+  auto worker_index = chain_worker(chain_id);
+  if (!worker_index.has_value()) {
+    promise.set_error(td::Status::Error("No workers available"));
+    return;
+  }
+  auto request_bytes = serialized_size(request);
+  send_worker_request_function<T>(
+      *worker_index,
+      std::move(request),
+      track_request(*worker_index, T::ID, request_bytes, resume_in_router(std::move(promise)))
+  );
+}
+
+template <typename T>
+void RequestChainContext::send(T request, td::Promise<typename T::ReturnType> promise) const {
+  td::actor::send_closure(
+      router_, &MultiClientActor::send_chain_request<T>, chain_id_, std::move(request), std::move(promise)
+  );
+}
+
+template <typename T>
+void RequestChainContext::send_function(
+    ton::tonlib_api::object_ptr<T> request, td::Promise<typename T::ReturnType> promise
+) const {
+  td::actor::send_closure(
+      router_, &MultiClientActor::send_chain_request_function<T>, chain_id_, std::move(request), std::move(promise)
+  );
 }
 
 }  // namespace multiclient
@@ -0,0 +1,171 @@
+#include "pinned_accounts.h"
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include "block/block.h"
+#include "multi_client_actor.h"
+#include "request.h"
+#include "td/actor/PromiseFuture.h"
+
+namespace multiclient {
+
+td::Status PinnedAccountStore::pin(const std::vector<std::string>& addresses) {
+  for (const auto& address : addresses) {
+    if (block::StdAddress::parse(address).is_error()) {
+      return td::Status::Error("Invalid account address: " + address);
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  for (const auto& address : addresses) {
+    accounts_.try_emplace(address);
+  }
+  return td::Status::OK();
+}
+
+void PinnedAccountStore::unpin(const std::vector<std::string>& addresses) {
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  for (const auto& address : addresses) {
+    accounts_.erase(address);
+  }
+}
+
+std::vector<std::string> PinnedAccountStore::addresses() const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::vector<std::string> result;
+  result.reserve(accounts_.size());
+  for (const auto& [address, _] : accounts_) {
+    result.push_back(address);
+  }
+  return result;
+}
+
+void PinnedAccountStore::update(
+    const std::string& address, ton::tonlib_api::object_ptr<ton::tonlib_api::raw_fullAccountState> state
+) {
+  auto mc_seqno = state->block_id_ != nullptr ? state->block_id_->seqno_ : -1;
+  std::shared_ptr<const ton::tonlib_api::raw_fullAccountState> shared_state = std::move(state);
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  auto it = accounts_.find(address);
+  if (it == accounts_.end() || it->second.mc_seqno > mc_seqno) {
+    return;
+  }
+  it->second = PinnedAccountState{
+      .state = std::move(shared_state),
+      .mc_seqno = mc_seqno,
+      .updated_at = std::chrono::steady_clock::now(),
+  };
+}
+
+td::Result<PinnedAccountState> PinnedAccountStore::get(
+    const std::string& address, std::optional<std::chrono::steady_clock::duration> max_age
+) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  auto it = accounts_.find(address);
+  if (it == accounts_.end()) {
+    return td::Status::Error("Account is not pinned");
+  }
+  if (it->second.state == nullptr) {
+    return td::Status::Error("Pinned account state is not loaded yet");
+  }
+  if (max_age.has_value() && std::chrono::steady_clock::now() - it->second.updated_at > *max_age) {
+    return td::Status::Error("Pinned account state is stale");
+  }
+  return it->second;
+}
+
+PinnedAccountsRefresher::PinnedAccountsRefresher(
+    td::actor::ActorId<MultiClientActor> router, std::shared_ptr<PinnedAccountStore> store
+) :
+    router_(std::move(router)), store_(std::move(store)) {
+}
+
+void PinnedAccountsRefresher::start_up() {
+  wait_for_head();
+}
+
+void PinnedAccountsRefresher::refresh() {
+  if (pending_count_ == 0 && known_head_ >= 0) {
+    start_refresh(known_head_);
+  }
+}
+
+void PinnedAccountsRefresher::wait_for_head() {
+  if (waiting_for_head_) {
+    return;
+  }
+  waiting_for_head_ = true;
+
+  td::actor::send_closure(
+      router_,
+      &MultiClientActor::wait_for_mc_seqno,
+      known_head_ + 1,
+      td::Promise<int32_t>([self_id = actor_id(this)](td::Result<int32_t> head) {
+        td::actor::send_closure(self_id, &PinnedAccountsRefresher::on_head, std::move(head));
+      })
+  );
+}
+
+void PinnedAccountsRefresher::on_head(td::Result<int32_t> head) {
+  waiting_for_head_ = false;
+  if (head.is_error()) {
+    LOG(WARNING) << "pinned accounts failed to wait for the cluster head: " << head.error();
+    return;
+  }
+
+  known_head_ = std::max(known_head_, head.ok());
+  if (pending_count_ == 0 && known_head_ > refreshed_seqno_) {
+    start_refresh(known_head_);
+  }
+  wait_for_head();
+}
+
+void PinnedAccountsRefresher::start_refresh(int32_t mc_seqno) {
+  auto addresses = store_->addresses();
+  refreshed_seqno_ = mc_seqno;
+  pending_count_ = addresses.size();
+
+  LOG(DEBUG) << "refreshing " << addresses.size() << " pinned accounts at mc block " << mc_seqno;
+
+  for (auto& address : addresses) {
+    auto promise = td::Promise<ton::tonlib_api::raw_getAccountState::ReturnType>(
+        [self_id = actor_id(this), address](auto result) mutable {
+          td::actor::send_closure(
+              self_id, &PinnedAccountsRefresher::on_account_state, std::move(address), std::move(result)
+          );
+        }
+    );
+
+    td::actor::send_closure(
+        router_,
+        &MultiClientActor::send_request_function<ton::tonlib_api::raw_getAccountState>,
+        RequestFunction<ton::tonlib_api::raw_getAccountState>{
+            .parameters = {.mode = RequestMode::Single, .min_mc_seqno = mc_seqno},
+            .request_creator =
+                [address]() {
+                  return ton::tonlib_api::make_object<ton::tonlib_api::raw_getAccountState>(
+                      ton::tonlib_api::make_object<ton::tonlib_api::accountAddress>(address)
+                  );
+                },
+        },
+        std::move(promise)
+    );
+  }
+}
+
+void PinnedAccountsRefresher::on_account_state(
+    std::string address, td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::raw_fullAccountState>> result
+) {
+  if (result.is_ok()) {
+    store_->update(address, result.move_as_ok());
+  } else {
+    LOG(DEBUG) << "failed to refresh pinned account " << address << ": " << result.error();
+  }
+
+  if (--pending_count_ == 0 && known_head_ > refreshed_seqno_) {
+    start_refresh(known_head_);
+  }
+}
+
+}  // namespace multiclient
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "auto/tl/tonlib_api.h"
+#include "td/actor/ActorId.h"
+#include "td/actor/actor.h"
+#include "td/utils/Status.h"
+
+namespace multiclient {
+
+class MultiClientActor;
+
+struct PinnedAccountState {
+  std::shared_ptr<const ton::tonlib_api::raw_fullAccountState> state;
+  int32_t mc_seqno = -1;
+  std::chrono::steady_clock::time_point updated_at;
+};
+
+// Latest `raw_fullAccountState` of every pinned address. Written by `PinnedAccountsRefresher` once per masterchain
+// block and read directly from the caller thread. Addresses are matched exactly as they were pinned.
+class PinnedAccountStore {
+public:
+  td::Status pin(const std::vector<std::string>& addresses);
+  void unpin(const std::vector<std::string>& addresses);
+  std::vector<std::string> addresses() const;
+
+  void update(const std::string& address, ton::tonlib_api::object_ptr<ton::tonlib_api::raw_fullAccountState> state);
+
+  td::Result<PinnedAccountState> get(
+      const std::string& address, std::optional<std::chrono::steady_clock::duration> max_age = std::nullopt
+  ) const;
+
+private:
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<std::string, PinnedAccountState> accounts_;
+};
+
+class PinnedAccountsRefresher : public td::actor::Actor {
+public:
+  PinnedAccountsRefresher(td::actor::ActorId<MultiClientActor> router, std::shared_ptr<PinnedAccountStore> store);
+
+  void start_up() final;
+  void refresh();
+
+private:
+  void wait_for_head();
+  void on_head(td::Result<int32_t> head);
+
+  void start_refresh(int32_t mc_seqno);
+  void on_account_state(
+      std::string address, td::Result<ton::tonlib_api::object_ptr<ton::tonlib_api::raw_fullAccountState>> result
+  );
+
+  const td::actor::ActorId<MultiClientActor> router_;
+  std::shared_ptr<PinnedAccountStore> store_;
+
+  int32_t known_head_ = -1;
+  int32_t refreshed_seqno_ = -1;
+  size_t pending_count_ = 0;
+  bool waiting_for_head_ = false;
+};
+
+}  // namespace multiclient
@@ -1,17 +1,24 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
 #include "td/actor/PromiseFuture.h"
+#include "td/utils/Time.h"
 
 namespace multiclient {
 
+// Resolves with the first success of `legs` promises, or with the last leg's error once all of them have failed.
 template <typename T>
 class PromiseSuccessAny {
 private:
   struct ControlBlock {
-    ControlBlock(td::Promise<T>&& p) : promise(std::move(p)) {
+    ControlBlock(td::Promise<T>&& p, size_t legs) : promise(std::move(p)), pending_count(legs) {
     }
 
     td::Promise<T> promise;
@@ -20,17 +27,18 @@ private:
   };
 
 public:
-  PromiseSuccessAny(td::Promise<T>&& promise) : control_block_(std::make_shared<ControlBlock>(std::move(promise))) {
+  PromiseSuccessAny(td::Promise<T>&& promise, size_t legs) :
+      control_block_(std::make_shared<ControlBlock>(std::move(promise), legs)) {
   }
 
   td::Promise<T> get_promise() {
-    control_block_->pending_count.fetch_add(1, std::memory_order_seq_cst);
     return [ctrl = control_block_](td::Result<T> res) {
       std::unique_lock<std::mutex> lock(ctrl->mutex);
+      // `fetch_sub` returns the count before this leg, so the last leg sees 1.
       auto pending_count = ctrl->pending_count.fetch_sub(1, std::memory_order_relaxed);
       if (!res.is_ok()) {
-        if (pending_count <= 0) {
-          ctrl->promise.set_error(td::Status::Error("All promises failed"));
+        if (pending_count <= 1) {
+          ctrl->promise.set_error(res.move_as_error());
         }
         return;
       }
@@ -42,4 +50,236 @@ private:
   std::shared_ptr<ControlBlock> control_block_;
 };
 
+// Resolves with the first `k` successes of `legs` promises, in the order they arrive, and fails as soon as fewer than
+// `k` successes remain possible. Results of the legs that finish later are dropped; tonlib cannot cancel them, so
+// they keep counting against their workers' in-flight and cost figures until they return.
+template <typename T>
+class PromiseFirstK {
+private:
+  struct ControlBlock {
+    td::Promise<std::vector<T>> promise;
+    size_t k = 0;
+    size_t pending = 0;
+    std::vector<T> results;
+    std::mutex mutex{};
+  };
+
+public:
+  PromiseFirstK(td::Promise<std::vector<T>>&& promise, size_t legs, size_t k) :
+      control_block_(std::make_shared<ControlBlock>()) {
+    control_block_->promise = std::move(promise);
+    control_block_->k = k;
+    control_block_->pending = legs;
+    control_block_->results.reserve(k);
+  }
+
+  td::Promise<T> get_promise() {
+    return [ctrl = control_block_](td::Result<T> res) {
+      std::unique_lock<std::mutex> lock(ctrl->mutex);
+      if (!ctrl->promise) {
+        return;
+      }
+      ctrl->pending--;
+
+      if (res.is_ok()) {
+        ctrl->results.push_back(res.move_as_ok());
+        if (ctrl->results.size() == ctrl->k) {
+          ctrl->promise.set_value(std::move(ctrl->results));
+        }
+        return;
+      }
+      if (ctrl->results.size() + ctrl->pending < ctrl->k) {
+        ctrl->promise.set_error(td::Status::Error(
+            "only " + std::to_string(ctrl->results.size() + ctrl->pending) + " of " + std::to_string(ctrl->k) +
+            " successes are still possible, last error: " + res.error().message().str()
+        ));
+      }
+    };
+  }
+
+private:
+  std::shared_ptr<ControlBlock> control_block_;
+};
+
+template <typename T>
+struct GatherResult {
+  size_t worker_index = 0;
+  td::Result<T> result;
+  // Seconds from sending to the response, or to the deadline for the legs that did not finish.
+  double latency = 0;
+};
+
+// Collects the result of every leg, in the order of `worker_indices`, and resolves once all legs have finished or the
+// deadline promise fires, whichever comes first.
+template <typename T>
+class PromiseGather {
+private:
+  struct ControlBlock {
+    std::vector<GatherResult<T>> results;
+    std::vector<bool> is_finished;
+    size_t pending = 0;
+    double started_at = 0;
+    td::Promise<std::vector<GatherResult<T>>> promise;
+    std::function<void()> on_finish;
+    std::mutex mutex{};
+
+    void finish() {
+      promise.set_value(std::move(results));
+      if (on_finish) {
+        on_finish();
+      }
+    }
+  };
+
+public:
+  PromiseGather(const std::vector<size_t>& worker_indices, td::Promise<std::vector<GatherResult<T>>>&& promise) :
+      control_block_(std::make_shared<ControlBlock>()) {
+    control_block_->results.resize(worker_indices.size());
+    for (size_t i = 0; i < worker_indices.size(); i++) {
+      control_block_->results[i].worker_index = worker_indices[i];
+    }
+    control_block_->is_finished.resize(worker_indices.size(), false);
+    control_block_->pending = worker_indices.size();
+    control_block_->started_at = td::Time::now();
+    control_block_->promise = std::move(promise);
+  }
+
+  // Called once the result is delivered, either way; must be set before the legs are sent.
+  void set_on_finish(std::function<void()> on_finish) {
+    control_block_->on_finish = std::move(on_finish);
+  }
+
+  td::Promise<T> get_promise(size_t slot) {
+    return [ctrl = control_block_, slot](td::Result<T> res) {
+      std::unique_lock<std::mutex> lock(ctrl->mutex);
+      if (!ctrl->promise || ctrl->is_finished[slot]) {
+        return;
+      }
+      ctrl->is_finished[slot] = true;
+      ctrl->results[slot].result = std::move(res);
+      ctrl->results[slot].latency = td::Time::now() - ctrl->started_at;
+      if (--ctrl->pending == 0) {
+        ctrl->finish();
+      }
+    };
+  }
+
+  td::Promise<td::Unit> get_deadline_promise() {
+    return [ctrl = control_block_](td::Result<td::Unit>) {
+      std::unique_lock<std::mutex> lock(ctrl->mutex);
+      if (!ctrl->promise) {
+        return;
+      }
+      auto latency = td::Time::now() - ctrl->started_at;
+      for (size_t i = 0; i < ctrl->results.size(); i++) {
+        if (!ctrl->is_finished[i]) {
+          ctrl->results[i].result = td::Status::Error("Deadline exceeded");
+          ctrl->results[i].latency = latency;
+        }
+      }
+      ctrl->finish();
+    };
+  }
+
+private:
+  std::shared_ptr<ControlBlock> control_block_;
+};
+
+// Prefers the success of the freshest worker. A success from a worker at `head_mc_seqno` resolves at once. Otherwise
+// the first success opens a window of `window` seconds, during which a success from a worker at a higher masterchain
+// seqno replaces it. Resolves with the best success when the window closes or every leg has finished; an open window
+// that did not close it is handed to `cancel_deadline`.
+template <typename T>
+class PromiseFreshest {
+public:
+  using ScheduleDeadlineFunc = std::function<void(td::Timestamp, td::Promise<td::Unit>)>;
+  using CancelDeadlineFunc = std::function<void(td::Timestamp)>;
+
+private:
+  struct ControlBlock {
+    td::Promise<T> promise;
+    size_t pending = 0;
+    int32_t head_mc_seqno = 0;
+    double window = 0;
+    ScheduleDeadlineFunc schedule_deadline;
+    CancelDeadlineFunc cancel_deadline;
+    std::optional<td::Timestamp> deadline;
+    std::optional<T> best;
+    int32_t best_mc_seqno = 0;
+    std::mutex mutex{};
+
+    // Called under `mutex`, so the cancellation is always sent after the deadline it cancels.
+    void finish(td::Result<T> result) {
+      promise.set_result(std::move(result));
+      if (deadline.has_value()) {
+        cancel_deadline(*deadline);
+      }
+    }
+  };
+
+public:
+  PromiseFreshest(
+      td::Promise<T>&& promise,
+      size_t legs,
+      int32_t head_mc_seqno,
+      double window,
+      ScheduleDeadlineFunc schedule_deadline,
+      CancelDeadlineFunc cancel_deadline
+  ) :
+      control_block_(std::make_shared<ControlBlock>()) {
+    control_block_->promise = std::move(promise);
+    control_block_->pending = legs;
+    control_block_->head_mc_seqno = head_mc_seqno;
+    control_block_->window = window;
+    control_block_->schedule_deadline = std::move(schedule_deadline);
+    control_block_->cancel_deadline = std::move(cancel_deadline);
+  }
+
+  // `worker_mc_seqno` is the last masterchain seqno the leg's worker reported.
+  td::Promise<T> get_promise(int32_t worker_mc_seqno) {
+    return [ctrl = control_block_, worker_mc_seqno](td::Result<T> res) {
+      std::unique_lock<std::mutex> lock(ctrl->mutex);
+      if (!ctrl->promise) {
+        return;
+      }
+      ctrl->pending--;
+
+      if (res.is_ok()) {
+        if (worker_mc_seqno >= ctrl->head_mc_seqno) {
+          ctrl->finish(res.move_as_ok());
+          return;
+        }
+
+        bool is_first = !ctrl->best.has_value();
+        if (is_first || worker_mc_seqno > ctrl->best_mc_seqno) {
+          ctrl->best = res.move_as_ok();
+          ctrl->best_mc_seqno = worker_mc_seqno;
+        }
+        if (is_first && ctrl->pending > 0) {
+          ctrl->deadline = td::Timestamp::in(ctrl->window);
+          ctrl->schedule_deadline(*ctrl->deadline, [ctrl](td::Result<td::Unit>) {
+            std::unique_lock<std::mutex> lock(ctrl->mutex);
+            // A cancelled deadline finds the promise already resolved.
+            if (ctrl->promise) {
+              ctrl->deadline.reset();
+              ctrl->finish(std::move(*ctrl->best));
+            }
+          });
+        }
+      }
+
+      if (ctrl->pending == 0) {
+        if (ctrl->best.has_value()) {
+          ctrl->finish(std::move(*ctrl->best));
+        } else {
+          ctrl->finish(res.is_error() ? res.move_as_error() : td::Status::Error("All promises failed"));
+        }
+      }
+    };
+  }
+
+private:
+  std::shared_ptr<ControlBlock> control_block_;
+};
+
 }  // namespace multiclient
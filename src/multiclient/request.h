@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <optional>
 #include <string>
+#include <variant>
+#include <vector>
 #include "auto/tl/tonlib_api.h"
 
 namespace multiclient {
@@ -12,6 +15,21 @@ enum class RequestMode : uint8_t {
   Single,
   Broadcast,
   Multiple,
+  // Every suitable worker, or the ones in `lite_server_indexes`; used with `MultiClient::gather`, which returns all
+  // responses. Other calls treat it like `Broadcast`.
+  Gather,
+  // Like `Gather` in worker selection, but answers with one response: the one from the worker with the highest
+  // masterchain seqno among those that succeed within `freshness_window` seconds of the first success.
+  Freshest,
+  // Like `Gather` in worker selection; used with `MultiClient::first_k`. Other calls treat it like `Broadcast`.
+  FirstK,
+};
+
+enum class RoutingPolicy : uint8_t {
+  // Workers with the lowest estimated outstanding cost.
+  LeastLoaded,
+  // Workers with the best latency and error profile for the requested TL function, then the least loaded.
+  BestForMethod,
 };
 
 struct RequestParameters {
@@ -19,10 +37,20 @@ struct RequestParameters {
   std::optional<std::vector<size_t>> lite_server_indexes = std::nullopt;
   std::optional<size_t> clients_number = std::nullopt;
   bool archival = false;
+  // Use archival workers when some are suitable, any suitable worker otherwise.
+  bool prefer_archival = false;
+  std::optional<int32_t> min_mc_seqno = std::nullopt;
+  // When set, a request whose `min_mc_seqno` no alive worker has reached yet is parked for up to this many seconds
+  // until one does, instead of failing with "No workers available".
+  std::optional<double> min_mc_seqno_wait = std::nullopt;
+  RoutingPolicy routing = RoutingPolicy::LeastLoaded;
+  // Seconds to wait for the slower workers in `MultiClient::gather`, 60 by default.
+  std::optional<double> timeout = std::nullopt;
+  double freshness_window = 0.2;
 
   bool are_valid() const {
     if (mode == RequestMode::Single) {
-      return !lite_server_indexes->empty() && lite_server_indexes->size() == 1;
+      return !lite_server_indexes.has_value() || lite_server_indexes->size() == 1;
     }
 
     if (mode == RequestMode::Multiple) {
@@ -57,6 +85,11 @@ struct RequestFunction {
   CreateTonlibRequestFunc request_creator;
 };
 
+// `RequestCallback::request_id` values with this bit set are reserved for the requests the library makes itself.
+inline constexpr uint64_t kReservedRequestIdBit = uint64_t{1} << 63;
+// Reserved ids with this bit set as well are the tokens `CallbackCombiner` sends in place of a user id.
+inline constexpr uint64_t kCombinedRequestIdBit = uint64_t{1} << 62;
+
 struct RequestCallback {
   using CreateTonlibCallbackRequestFunc = std::function<ton::tonlib_api::object_ptr<ton::tonlib_api::Function>()>;
 
@@ -65,6 +98,25 @@ struct RequestCallback {
   size_t request_id = 999;
 };
 
+// Raw `lite_api` query sent over the direct lite server connection of a worker, bypassing `TonlibClient`.
+template <typename T>
+struct RequestLite {
+  using CreateLiteRequestFunc = std::function<T()>;
+
+  RequestParameters parameters;
+  CreateLiteRequestFunc request_creator;
+};
+
+struct RequestGetMethod {
+  using CreateStackFunc = std::function<std::vector<ton::tonlib_api::object_ptr<ton::tonlib_api::tvm_StackEntry>>()>;
+
+  RequestParameters parameters;
+  std::string address;
+  // Either a method name or a numeric method id.
+  std::variant<std::string, int32_t> method;
+  CreateStackFunc stack_creator = nullptr;
+};
+
 struct RequestJson {
   RequestParameters parameters;
   std::string request;
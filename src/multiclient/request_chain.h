@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "auto/tl/tonlib_api.h"
+#include "request.h"
+#include "td/actor/ActorId.h"
+#include "td/actor/PromiseFuture.h"
+
+namespace multiclient {
+
+class MultiClientActor;
+
+// Handle passed to the steps of a `RequestChain`. Requests sent through it go to the worker the chain is pinned to, and
+// their promises are resolved on the router, so the next step can be built right away without a round trip through
+// the caller thread.
+class RequestChainContext {
+public:
+  RequestChainContext(td::actor::ActorId<MultiClientActor> router, uint64_t chain_id) :
+      router_(std::move(router)), chain_id_(chain_id) {
+  }
+
+  template <typename T>
+  void send(T request, td::Promise<typename T::ReturnType> promise) const;
+
+  // Same as `send`, for the functions that need `RequestFunction`.
+  template <typename T>
+  void send_function(ton::tonlib_api::object_ptr<T> request, td::Promise<typename T::ReturnType> promise) const;
+
+  // Sends all requests at once; resolves with the results in input order or with the first error.
+  template <typename T>
+  void send_all(std::vector<T> requests, td::Promise<std::vector<typename T::ReturnType>> promise) const;
+
+private:
+  td::actor::ActorId<MultiClientActor> router_;
+  uint64_t chain_id_;
+};
+
+// A chain or small DAG of dependent requests that runs inside the router. `start` is called on the router and sends the
+// first requests through the context; their continuations build the next ones. Only `RequestMode::Single` is supported:
+// the chain sticks to one worker and moves to another only if that one stops being suitable.
+template <typename R>
+struct RequestChain {
+  using StartFunc = std::function<void(RequestChainContext context, td::Promise<R> promise)>;
+
+  RequestParameters parameters;
+  StartFunc start;
+};
+
+template <typename T>
+void RequestChainContext::send_all(
+    std::vector<T> requests, td::Promise<std::vector<typename T::ReturnType>> promise
+) const {
+  using ReturnType = typename T::ReturnType;
+
+  // Continuations run on the router one at a time, so the shared state needs no locking.
+  struct State {
+    std::vector<ReturnType> results;
+    size_t pending = 0;
+    td::Promise<std::vector<ReturnType>> promise;
+  };
+
+  if (requests.empty()) {
+    promise.set_value(std::vector<ReturnType>{});
+    return;
+  }
+
+  auto state = std::make_shared<State>();
+  state->results.resize(requests.size());
+  state->pending = requests.size();
+  state->promise = std::move(promise);
+
+  for (size_t i = 0; i < requests.size(); i++) {
+    send(std::move(requests[i]), [state, i](td::Result<ReturnType> result) {
+      if (!state->promise) {
+        return;
+      }
+      if (result.is_error()) {
+        state->promise.set_error(result.move_as_error());
+        return;
+      }
+      state->results[i] = result.move_as_ok();
+      if (--state->pending == 0) {
+        state->promise.set_value(std::move(state->results));
+      }
+    });
+  }
+}
+
+}  // namespace multiclient
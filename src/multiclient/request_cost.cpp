@@ -0,0 +1,74 @@
+#include "request_cost.h"
+#include <algorithm>
+#include "auto/tl/lite_api.h"
+#include "auto/tl/tonlib_api.h"
+
+namespace multiclient {
+
+double RequestCostModel::estimate(int32_t function_id) const {
+  static constexpr uint64_t kFullConfidenceSamples = 16;
+
+  auto cost = default_cost(function_id);
+  auto it = entries_.find(function_id);
+  if (it == entries_.end()) {
+    return cost;
+  }
+
+  // Blend the default with the observed latency until there are enough samples to trust the latter.
+  auto weight = static_cast<double>(std::min(it->second.samples, kFullConfidenceSamples)) / kFullConfidenceSamples;
+  return cost + weight * (it->second.avg_latency - cost);
+}
+
+size_t RequestCostModel::expected_response_bytes(int32_t function_id) const {
+  auto it = entries_.find(function_id);
+  return it == entries_.end() ? 0 : static_cast<size_t>(it->second.avg_response_bytes);
+}
+
+void RequestCostModel::on_request_finished(int32_t function_id, double latency, bool is_ok, size_t response_bytes) {
+  static constexpr double kLatencyWeight = 0.05;
+
+  // Failures are often fast and say little about the cost of the request.
+  if (!is_ok) {
+    return;
+  }
+
+  auto& entry = entries_[function_id];
+  auto bytes = static_cast<double>(response_bytes);
+  entry.avg_latency = entry.samples == 0 ? latency : entry.avg_latency + kLatencyWeight * (latency - entry.avg_latency);
+  entry.avg_response_bytes = entry.samples == 0 ?
+      bytes :
+      entry.avg_response_bytes + kLatencyWeight * (bytes - entry.avg_response_bytes);
+  entry.samples++;
+}
+
+double RequestCostModel::default_cost(int32_t function_id) {
+  static constexpr double kDefaultCost = 0.1;
+
+  switch (function_id) {
+    case ton::tonlib_api::blocks_getMasterchainInfo::ID:
+    case ton::tonlib_api::getConfigParam::ID:
+    case ton::lite_api::liteServer_getMasterchainInfo::ID:
+      return 0.02;
+
+    case ton::tonlib_api::raw_getAccountState::ID:
+    case ton::tonlib_api::getAccountState::ID:
+    case ton::tonlib_api::blocks_lookupBlock::ID:
+    case ton::tonlib_api::blocks_getShards::ID:
+    case ton::tonlib_api::blocks_getBlockHeader::ID:
+      return 0.05;
+
+    case ton::tonlib_api::smc_load::ID:
+    case ton::tonlib_api::smc_runGetMethod::ID:
+      return 0.2;
+
+    case ton::tonlib_api::raw_getTransactions::ID:
+    case ton::tonlib_api::raw_getTransactionsV2::ID:
+    case ton::tonlib_api::blocks_getTransactions::ID:
+      return 0.3;
+
+    default:
+      return kDefaultCost;
+  }
+}
+
+}  // namespace multiclient
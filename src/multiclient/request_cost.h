@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+namespace multiclient {
+
+// Expected cost of a request, in seconds of lite server time, keyed by TL function id. Starts from static defaults per
+// function type and moves to the observed latency of successful requests as samples come in. Also averages the
+// serialized size of the responses, which the router reserves for the requests in flight.
+class RequestCostModel {
+public:
+  double estimate(int32_t function_id) const;
+  // 0 until a response of the function has been seen.
+  size_t expected_response_bytes(int32_t function_id) const;
+  void on_request_finished(int32_t function_id, double latency, bool is_ok, size_t response_bytes);
+
+  static double default_cost(int32_t function_id);
+
+private:
+  struct Entry {
+    double avg_latency = 0;
+    double avg_response_bytes = 0;
+    uint64_t samples = 0;
+  };
+
+  std::unordered_map<int32_t, Entry> entries_;
+};
+
+}  // namespace multiclient
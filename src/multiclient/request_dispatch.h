@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include "auto/tl/tonlib_api.h"
+
+namespace multiclient {
+
+enum class DispatchPath : uint8_t {
+  // `TonlibClient::make_request`: the typed promise goes straight to tonlib.
+  MakeRequest,
+  // `TonlibClient::request` with the result matched back through `ClientWrapper::tracking_requests_` and downcast from
+  // a type-erased `Object`.
+  Callback,
+};
+
+template <typename T, typename... Ts>
+inline constexpr bool kIsOneOf = (std::is_same_v<T, Ts> || ...);
+
+// Functions that `TonlibClient::make_request` cannot process, i.e. it either does not compile for them or answers with
+// an error, so they have to go through `TonlibClient::request`. The list is not derived from tonlib's sources but from
+// the functions this library already sends on the callback path: `raw_getAccountState` is the case `RequestFunction`
+// was added for, `ClientWrapper` runs get-methods with the `smc_*` functions and answers the network callbacks with
+// the `onLiteServerQuery*` ones. Another function that fails through `make_request` belongs here as well.
+template <typename T>
+inline constexpr bool kNeedsCallbackDispatch = kIsOneOf<
+    T,
+    ton::tonlib_api::raw_getAccountState,
+    ton::tonlib_api::smc_load,
+    ton::tonlib_api::smc_runGetMethod,
+    ton::tonlib_api::smc_forget,
+    ton::tonlib_api::onLiteServerQueryResult,
+    ton::tonlib_api::onLiteServerQueryError>;
+
+// Dispatch path of every TL function for `MultiClient::send`; specialize to move a function to the other path.
+template <typename T>
+struct RequestDispatchTraits {
+  static constexpr DispatchPath path = kNeedsCallbackDispatch<T> ? DispatchPath::Callback : DispatchPath::MakeRequest;
+};
+
+// Functions that read or write the keystore, or the queries created with its keys, which tonlib keeps per client. In
+// `KeyStoreMode::Shared` only the owner of the keystore can answer them, so the router sends them there.
+inline bool uses_key_store(int32_t function_id) {
+  switch (function_id) {
+    case ton::tonlib_api::createNewKey::ID:
+    case ton::tonlib_api::deleteKey::ID:
+    case ton::tonlib_api::deleteAllKeys::ID:
+    case ton::tonlib_api::exportKey::ID:
+    case ton::tonlib_api::exportPemKey::ID:
+    case ton::tonlib_api::exportEncryptedKey::ID:
+    case ton::tonlib_api::exportUnencryptedKey::ID:
+    case ton::tonlib_api::importKey::ID:
+    case ton::tonlib_api::importPemKey::ID:
+    case ton::tonlib_api::importEncryptedKey::ID:
+    case ton::tonlib_api::importUnencryptedKey::ID:
+    case ton::tonlib_api::changeLocalPassword::ID:
+    case ton::tonlib_api::createQuery::ID:
+    case ton::tonlib_api::msg_decrypt::ID:
+    case ton::tonlib_api::pchan_signPromise::ID:
+    case ton::tonlib_api::query_getInfo::ID:
+    case ton::tonlib_api::query_estimateFees::ID:
+    case ton::tonlib_api::query_send::ID:
+    case ton::tonlib_api::query_forget::ID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace multiclient
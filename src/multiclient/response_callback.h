@@ -1,16 +1,38 @@
 #pragma once
 
 #include <cstdint>
+#include <span>
 #include "auto/tl/tonlib_api.h"
 
 namespace multiclient {
 
+// One response of a `RequestCallback`; exactly one of `result` and `error` is set.
+struct CallbackResponse {
+  int64_t client_id = 0;
+  uint64_t id = 0;
+  ton::tonlib_api::object_ptr<ton::tonlib_api::Object> result;
+  ton::tonlib_api::object_ptr<ton::tonlib_api::error> error;
+};
+
 class ResponseCallback {
 public:
   virtual void on_result(
       int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::Object> result
   ) = 0;
   virtual void on_error(int64_t client_id, uint64_t id, ton::tonlib_api::object_ptr<ton::tonlib_api::error> error) = 0;
+
+  // Called instead of `on_result` / `on_error` when `MultiClientConfig::callback_dispatch` is set. The default
+  // implementation forwards every response to them.
+  virtual void on_results(std::span<CallbackResponse> responses) {
+    for (auto& response : responses) {
+      if (response.error != nullptr) {
+        on_error(response.client_id, response.id, std::move(response.error));
+      } else {
+        on_result(response.client_id, response.id, std::move(response.result));
+      }
+    }
+  }
+
   virtual ~ResponseCallback() = default;
 };
 
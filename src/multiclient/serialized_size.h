@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include "auto/tl/lite_api.h"
+#include "auto/tl/tonlib_api.h"
+#include "auto/tl/tonlib_api_json.h"
+#include "td/utils/JsonBuilder.h"
+#include "td/utils/buffer.h"
+#include "td/utils/tl_storers.h"
+#include "tl/tl_json.h"
+
+namespace multiclient {
+
+// Size of a request or response in the form it travels in: lite_api objects in their boxed TL encoding, tonlib_api
+// objects in tonlib's JSON encoding, which is the only serialization tonlib_api has.
+inline size_t serialized_size(const std::string& data) {
+  return data.size();
+}
+
+inline size_t serialized_size(const td::BufferSlice& data) {
+  return data.size();
+}
+
+template <typename T>
+size_t serialized_size(const T& object) {
+  if constexpr (std::is_base_of_v<ton::lite_api::Object, T> || std::is_base_of_v<ton::lite_api::Function, T>) {
+    td::TlStorerCalcLength storer;
+    storer.store_binary(object.get_id());
+    object.store(storer);
+    return storer.get_length();
+  } else {
+    return td::json_encode<std::string>(td::ToJson(object)).size();
+  }
+}
+
+template <typename T>
+size_t serialized_size(const std::unique_ptr<T>& object) {
+  return object == nullptr ? 0 : serialized_size(*object);
+}
+
+}  // namespace multiclient